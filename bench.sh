@@ -0,0 +1,74 @@
+#!/bin/sh
+# bench.sh
+#	Measure how fast the simulator itself runs: each test program
+#	under each kernel build, one CSV line per run.  Run from the top
+#	of the tree, after "make" (see the "bench" target in Makefile).
+#
+#	Usage: sh bench.sh [output file]	(standard output by default)
+#
+#	The columns are:
+#	    build, program	-- which nachos, and which test program
+#	    status		-- ok, or the exit status if nachos failed
+#	    host_seconds	-- host wall time from startup to Halt
+#	    instructions	-- user instructions simulated
+#	    instructions_per_second	-- of host time
+#	    page_faults, page_faults_per_second
+#	    tlb_misses, tlb_miss_us	-- host microseconds a miss took to
+#					   handle (0 without a TLB)
+#
+#	Under the file system build, each program is first copied onto a 
+#	freshly formatted Nachos disk.  The shell is not among the programs,
+#	as it needs Read, Write and Exec, which the kernel doesn't implement.
+#
+# Copyright (c) 1992 The Regents of the University of California.
+# All rights reserved.  See copyright.h for copyright notice and limitation
+# of liability and disclaimer of warranty provisions.
+
+BUILDS=${BUILDS:-"userprog vm filesys"}
+PROGRAMS=${PROGRAMS:-"halt matmult sort"}
+OUT=${1:-/dev/stdout}
+LOG=/tmp/bench.$$
+
+# run program $2 under build $1, leaving nachos' output in $LOG
+run() {
+    if [ $1 = filesys ]; then
+	(cd $1; ./nachos -f -cp ../test/$2 $2 > /dev/null 2>&1)
+	prog=$2
+    else
+	prog=../test/$2
+    fi
+    (cd $1; ./nachos -x $prog < /dev/null) > $LOG 2>&1
+}
+
+# the number after "$2" on the line of $LOG starting with "$1"
+field() {
+    sed -n "s/^$1.*$2 \([0-9.]*\).*/\1/p" $LOG | head -1
+}
+
+# the number before "$2" on the line of $LOG starting with "$1"
+before() {
+    sed -n "s/^$1.* \([0-9.]*\) $2.*/\1/p" $LOG | head -1
+}
+
+echo "build,program,status,host_seconds,instructions,instructions_per_second,page_faults,page_faults_per_second,tlb_misses,tlb_miss_us" > $OUT
+for build in $BUILDS; do
+    if [ ! -x $build/nachos ]; then
+	echo "bench.sh: no $build/nachos; run make first" 1>&2
+	continue
+    fi
+    for prog in $PROGRAMS; do
+	run $build $prog
+	status=$?
+	[ $status = 0 ] && status=ok
+	seconds=`field Simulator: "host time"`
+	speed=`before Simulator: "user instructions"`
+	user=`sed -n 's/^Ticks:.*user \([0-9]*\).*/\1/p' $LOG | head -1`
+	faults=`field Paging: faults`
+	misses=`field Paging: miss`
+	faultrate=`before Host: "page faults"`
+	misscost=`before Host: "microseconds"`
+	# a user instruction is one user tick (see UserTick in stats.h)
+	echo "$build,$prog,$status,${seconds:-0},${user:-0},${speed:-0},${faults:-0},${faultrate:-0},${misses:-0},${misscost:-0}" >> $OUT
+    done
+done
+rm -f $LOG
@@ -52,6 +52,8 @@ class OpenFile {
 		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+    int Identity() { return FileId(file); }	// the same for every
+							// open of the file
     
   private:
     int file;
@@ -85,9 +87,12 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+    int Identity() { return hdrSector; }	// The same for every open of
+					// the file: its header sector
     
   private:
     FileHeader *hdr;			// Header for this file 
+    int hdrSector;			// Where the header is on disk
     int seekPosition;			// Current position within the file
 };
 
@@ -50,6 +50,137 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     type = kind;
 }
 
+//----------------------------------------------------------------------
+// FiresBefore
+// 	Return TRUE if interrupt "a" is to fire before interrupt "b": it
+//	is due sooner, or at the same time but was scheduled first.  
+//	"order" may wrap around, so compare the difference.
+//----------------------------------------------------------------------
+
+static inline bool
+FiresBefore(PendingInterrupt *a, PendingInterrupt *b)
+{
+    if (a->when != b->when)
+	return (a->when < b->when);
+    return ((int) (a->order - b->order) < 0);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::PendingQueue
+// 	Initialize an empty queue of pending interrupts.  The heap grows
+//	as needed.
+//----------------------------------------------------------------------
+
+PendingQueue::PendingQueue()
+{
+    size = 16;
+    heap = new PendingInterrupt *[size];
+    count = 0;
+    nextOrder = 0;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::~PendingQueue
+// 	De-allocate the queue.  The caller is responsible for the 
+//	interrupts still on it.
+//----------------------------------------------------------------------
+
+PendingQueue::~PendingQueue()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Insert
+// 	Put an interrupt on the queue: add it at the bottom of the heap,
+//	and move it up past every interrupt due later than it.
+//
+//	"item" is the interrupt to schedule; it is ordered after every
+//		interrupt already on the queue that is due at the same time
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Insert(PendingInterrupt *item)
+{
+    int i, parent;
+
+    if (count == size) {		// out of room, double the heap
+	PendingInterrupt **bigger = new PendingInterrupt *[2 * size];
+
+	for (i = 0; i < count; i++)
+	    bigger[i] = heap[i];
+	delete [] heap;
+	heap = bigger;
+	size *= 2;
+    }
+    item->order = nextOrder++;
+    for (i = count++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (!FiresBefore(item, heap[parent]))
+	    break;
+	heap[i] = heap[parent];
+    }
+    heap[i] = item;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Remove
+// 	Take the next interrupt to fire off the queue: replace the top
+//	of the heap with its last element, and move that down until 
+//	neither child fires before it.
+//
+// Returns:
+//	The interrupt, or NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+PendingQueue::Remove()
+{
+    PendingInterrupt *first, *last;
+    int i, child;
+
+    if (count == 0)
+	return NULL;
+    first = heap[0];
+    last = heap[--count];
+    for (i = 0; (child = 2 * i + 1) < count; i = child) {
+	if (child + 1 < count && FiresBefore(heap[child + 1], heap[child]))
+	    child++;
+	if (!FiresBefore(heap[child], last))
+	    break;
+	heap[i] = heap[child];
+    }
+    heap[i] = last;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Mapcar
+// 	Apply a function to each interrupt on the queue, in the order
+//	they will fire.  Only used for debugging, so we just sort a copy
+//	of the heap.
+//
+//	"func" is the procedure to apply to each interrupt
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Mapcar(VoidFunctionPtr func)
+{
+    PendingInterrupt **sorted = new PendingInterrupt *[count + 1];
+    PendingInterrupt *item;
+    int i, j;
+
+    for (i = 0; i < count; i++) {	// insertion sort
+	item = heap[i];
+	for (j = i; j > 0 && FiresBefore(item, sorted[j - 1]); j--)
+	    sorted[j] = sorted[j - 1];
+	sorted[j] = item;
+    }
+    for (i = 0; i < count; i++)
+	(*func)((int) sorted[i]);
+    delete [] sorted;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Interrupt
 // 	Initialize the simulation of hardware device interrupts.
@@ -60,7 +191,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new PendingQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -74,7 +205,7 @@ Interrupt::Interrupt()
 Interrupt::~Interrupt()
 {
     while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
+	delete pending->Remove();
     delete pending;
 }
 
@@ -97,7 +228,7 @@ void
 Interrupt::ChangeLevel(IntStatus old, IntStatus now)
 {
     level = now;
-    DEBUG('i',"\tinterrupts: %s -> %s\n",intLevelNames[old],intLevelNames[now]);
+    TRACE('i',"\tinterrupts: %s -> %s\n",intLevelNames[old],intLevelNames[now]);
 }
 
 //----------------------------------------------------------------------
@@ -138,6 +269,22 @@ Interrupt::Enable()
     (void) SetLevel(IntOn); 
 }
 
+//----------------------------------------------------------------------
+// AgePages
+// 	With aging page replacement, shift the pages' use bits into their
+//	history once every AgingInterval ticks (see PageTable::Age).
+//----------------------------------------------------------------------
+
+static void
+AgePages()
+{
+#ifdef USER_PROGRAM
+    if (machine != NULL && machine->pageTable != NULL 
+		&& stats->totalTicks >= machine->pageTable->nextAging)
+	machine->pageTable->Age();
+#endif
+}
+
 //----------------------------------------------------------------------
 // Interrupt::OneTick
 // 	Advance simulated time and check if there are any pending 
@@ -168,7 +315,8 @@ Interrupt::OneTick()
 	currentThread->reduceSlice(UserTick);
 	
     }
-    DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
+    AgePages();
+    TRACE('i', "\n== Tick %d ==\n", stats->totalTicks);
 	
 	
 
@@ -201,6 +349,54 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::UserTicksBeforeDue
+// 	Return how many user instructions can be executed, charging only
+//	their ticks, before a call to OneTick could do anything more:
+//	fire a pending interrupt, yield because the timer asked for a
+//	context switch and the time slice is used up, or age the pages.
+//
+//	Nothing else can change the answer without the kernel running,
+//	and the kernel only runs on an exception or from OneTick.
+//----------------------------------------------------------------------
+
+int
+Interrupt::UserTicksBeforeDue()
+{
+    PendingInterrupt *next = pending->Peek();
+    int ticks;
+
+    if (next == NULL)
+	ticks = 0x7fffffff;
+    else
+	ticks = (next->when - stats->totalTicks - 1) / UserTick;
+    if (yieldOnReturn && (currentThread->getSlice() - 1) / UserTick < ticks)
+	ticks = (currentThread->getSlice() - 1) / UserTick;
+#ifdef USER_PROGRAM
+    if (machine->pageTable != NULL && (machine->pageTable->nextAging 
+		- stats->totalTicks - 1) / UserTick < ticks)
+	ticks = (machine->pageTable->nextAging - stats->totalTicks - 1) 
+		/ UserTick;
+#endif
+    return (ticks > 0) ? ticks : 0;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::AdvanceUserTicks
+// 	Advance simulated time for "count" user instructions at once,
+//	exactly as "count" calls to OneTick in user mode would, given 
+//	that none of them has an interrupt to fire (see 
+//	UserTicksBeforeDue).
+//----------------------------------------------------------------------
+
+void
+Interrupt::AdvanceUserTicks(int count)
+{
+    stats->totalTicks += count * UserTick;
+    stats->userTicks += count * UserTick;
+    currentThread->reduceSlice(count * UserTick);
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -264,6 +460,10 @@ void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
+#ifdef USER_PROGRAM
+    if (machine != NULL)		// the counts not charged yet
+	machine->FlushCounts();
+#endif
     stats->Print();
     Cleanup();     // Never returns.
 }
@@ -294,7 +494,7 @@ Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(toOccur);
 }
 
 //----------------------------------------------------------------------
@@ -314,30 +514,32 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
-    int when;
 
     ASSERT(level == IntOff);		// interrupts need to be disabled,
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *toOccur = pending->Remove();
+    int when;
 
     if (toOccur == NULL)		// no pending interrupts
 	return FALSE;			
+    when = toOccur->when;
 
+    // An interrupt that is put back goes behind any others due at the
+    // same time, as it always has.
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
     } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+	pending->Insert(toOccur);
 	return FALSE;
     }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
 				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+	 pending->Insert(toOccur);
 	 return FALSE;
     }
 
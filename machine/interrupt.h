@@ -67,6 +67,43 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    unsigned order;		// Among interrupts with the same "when",
+				// those with smaller "order" fire first; 
+				// set by PendingQueue::Insert
+};
+
+// The following class defines the queue of interrupts scheduled to 
+// occur in the future, ordered by when they are to fire.  It is a 
+// binary heap, so that scheduling an interrupt and removing the next 
+// one are O(log n) rather than a walk down a sorted list.
+//
+// Interrupts scheduled for the same time come out in the order they 
+// were inserted, just as with List::SortedInsert.
+
+class PendingQueue {
+  public:
+    PendingQueue();			// initialize an empty queue
+    ~PendingQueue();			// de-allocate the queue (but not
+					// the interrupts still on it)
+
+    void Insert(PendingInterrupt *item);// Put an interrupt on the queue,
+					// after any others due at the same
+					// time
+    PendingInterrupt *Remove();		// Take the next interrupt to fire 
+					// off the queue (NULL if none)
+    PendingInterrupt *Peek() 		// The next interrupt to fire, left
+	{ return (count > 0) ? heap[0] : NULL; }	// on the queue 
+    bool IsEmpty() { return (count == 0); }
+
+    void Mapcar(VoidFunctionPtr func);	// Apply "func" to every interrupt
+					// on the queue, in firing order
+
+  private:
+    PendingInterrupt **heap;		// heap[i] fires no later than 
+					// heap[2i+1] and heap[2i+2]
+    int count;				// number of interrupts on the queue
+    int size;				// number of slots in "heap"
+    unsigned nextOrder;			// "order" for the next Insert
 };
 
 // The following class defines the data structures for the simulation
@@ -112,9 +149,16 @@ class Interrupt {
     
     void OneTick();       		// Advance simulated time
 
+    int UserTicksBeforeDue();		// How many user instructions can
+					// run before an interrupt is due
+					// or the time slice forces a yield
+    void AdvanceUserTicks(int count);	// Charge "count" user instructions
+					// at once; only legal if no more 
+					// than UserTicksBeforeDue()
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
+    PendingQueue *pending;	// the queue of interrupts scheduled
 				// to occur in the future
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
@@ -18,6 +18,9 @@ static char* exceptionNames[] = { "no exception", "syscall",
 				"bus error", "address error", "overflow",
 				"illegal instruction", "TLB hit miss"};
 
+int pageSize = DefaultPageSize;		// set by -pagesize
+int numPhysPages = DefaultPhysPages;	// set by -mem
+
 //----------------------------------------------------------------------
 // CheckEndian
 // 	Check to be sure that the host really uses the format it says it 
@@ -50,27 +53,47 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"accurate" -- if TRUE, fetch, execute and tick one instruction
+//		at a time, rather than running whole basic blocks and 
+//		charging their ticks together.
+//	"tlbSize", "tlbWays", "tlbPolicy" -- the number of TLB entries, 
+//		how many of them a page can go in (0 for any), and how to
+//		pick one to replace, if there is a TLB.
+//	"pagePolicy" -- how to pick a page to replace when memory is full.
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool accurate, int tlbSize, int tlbWays,
+		 TLBPolicy tlbPolicy, PagePolicy pagePolicy)
 {
     int i;
 
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
-    mainMemory = new char[MemorySize];
-    for (i = 0; i < MemorySize; i++)
-      	mainMemory[i] = 0;
+    mainMemory = AllocMemory(MemorySize);	// zero, and only backed by 
+						// host memory once touched
+    decodedPages = new DecodedPage *[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+	decodedPages[i] = NULL;
 #ifdef USE_TLB
-    tlb = new TLBuffer(TLBSize);
-    pageTable = new PageTable(NumPhysPages);
+    tlb = new TLBuffer(tlbSize, (tlbWays == 0) ? tlbSize : tlbWays, 
+			tlbPolicy);
 #else	// use linear page table
 	printf("not using tlb\n");	
     tlb = NULL;
-    pageTable = NULL;
 #endif
+    // with or without a TLB, pages are brought in on demand
+    pageTable = new PageTable(NumPhysPages, pagePolicy);
+    pageDirectory = NULL;
+    lastSlot = -1;
+    InvalidateMemo();
 
     singleStep = debug;
+    cycleAccurate = accurate;
+    pendingTicks = 0;
+    numLoads = numStores = numBranches = 0;
+    countedTicks = stats->userTicks;
+    countedHits = stats->tlbHit;
+    countedMisses = stats->tlbMiss;
     CheckEndian();
 }
 
@@ -81,11 +104,40 @@ Machine::Machine(bool debug)
 
 Machine::~Machine()
 {
-    delete [] mainMemory;
+    FreeMemory(mainMemory, MemorySize);
+    for (int i = 0; i < NumPhysPages; i++)
+	delete decodedPages[i];
+    delete [] decodedPages;
     if (tlb != NULL)
         delete tlb;
 }
 
+//----------------------------------------------------------------------
+// Machine::FlushCounts
+// 	Charge the current thread, and its address space, with the events
+//	counted since the last call (see CountEvent).  Counting them one 
+//	at a time would slow down every instruction and memory access, so
+//	they are only added up as they happen: instructions, TLB hits and
+//	misses in the statistics the simulator keeps anyway, loads, stores
+//	and taken branches here.  Each thread is charged its own, since 
+//	this is called on every context switch away from a user program.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushCounts()
+{
+    CountEvent(InstrCounter, (stats->userTicks - countedTicks) / UserTick);
+    CountEvent(LoadCounter, numLoads);
+    CountEvent(StoreCounter, numStores);
+    CountEvent(BranchCounter, numBranches);
+    CountEvent(TLBHitCounter, stats->tlbHit - countedHits);
+    CountEvent(TLBMissCounter, stats->tlbMiss - countedMisses);
+    numLoads = numStores = numBranches = 0;
+    countedTicks = stats->userTicks;
+    countedHits = stats->tlbHit;
+    countedMisses = stats->tlbMiss;
+}
+
 //----------------------------------------------------------------------
 // Machine::RaiseException
 // 	Transfer control to the Nachos kernel from user mode, because
@@ -100,7 +152,14 @@ void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
-    
+
+    // the kernel must see the time taken by the instructions that ran
+    // before this one without being charged yet (see RunUntilDue)
+    if (pendingTicks > 0) {
+	interrupt->AdvanceUserTicks(pendingTicks);
+	pendingTicks = 0;
+    }
+
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
@@ -109,6 +168,26 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     interrupt->setStatus(UserMode);
 }
 
+//----------------------------------------------------------------------
+// Machine::InvalidateFrame
+// 	Throw away the decoded instructions of a physical page, because
+//	the kernel is about to (or just did) put a different virtual page 
+//	into it.  Stores from user code are caught in WriteMem instead.
+//
+//	"frame" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateFrame(int frame)
+{
+    ASSERT((frame >= 0) && (frame < NumPhysPages));
+    InvalidateMemo();
+    if (decodedPages[frame] != NULL) {
+	delete decodedPages[frame];
+	decodedPages[frame] = NULL;
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::Debugger
 // 	Primitive debugger for user programs.  Note that we can't use
@@ -28,13 +28,23 @@
 
 // Definitions related to the size, and format of user memory
 
-#define PageSize 	SectorSize 	// set the page size equal to
-					// the disk sector size, for
-					// simplicity
+// The page size and the number of physical pages are set when Nachos 
+// starts (-pagesize, -mem); by default the page size is equal to the
+// disk sector size, for simplicity.
 
-#define NumPhysPages    32
+#define DefaultPageSize	SectorSize
+#define DefaultPhysPages 32
+
+extern int pageSize;			// bytes in a page
+extern int numPhysPages;		// pages of physical memory
+
+#define PageSize 	pageSize
+#define NumPhysPages    numPhysPages
 #define MemorySize 	(NumPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+#define InstrsPerPage	(PageSize / 4)	// instruction slots in one page
+#define MaxVirtualPages	(0x80000000u / PageSize)
+					// a user address space spans 2 GB
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -54,6 +64,11 @@ enum ExceptionType { NoException,           // Everything ok!
 		     NumExceptionTypes
 };
 
+// The kinds of memory access the machine remembers its last translation
+// for (see Machine::MemoTranslate).
+
+enum MemoType { MemoFetch, MemoLoad, MemoStore, NumMemoTypes };
+
 // User program CPU state.  The full set of MIPS registers, plus a few
 // more because we need to be able to start/stop a user program between
 // any two instructions (thus we need to keep track of things like load
@@ -73,6 +88,25 @@ enum ExceptionType { NoException,           // Everything ok!
 
 #define NumTotalRegs 	40
 
+#ifdef THREADED_DISPATCH
+// The effects of an instruction that are only installed once it has
+// completed without an exception: where the PC goes after the next
+// instruction, and the register to change with a delayed load.
+
+class ExecState {
+  public:
+    int pcAfter;		// the value for NextPCReg
+    int nextLoadReg;		// the delayed load this instruction
+    int nextLoadValue;		// starts, if any
+};
+
+class Instruction;
+
+// A routine that executes one kind of instruction (see mipssim.cc)
+typedef bool (*OpHandler)(int *registers, Instruction *instr, 
+				ExecState *state);
+#endif
+
 // The following class defines an instruction, represented in both
 // 	undecoded binary form
 //      decoded to identify
@@ -91,6 +125,26 @@ class Instruction {
     char rs, rt, rd; // Three registers from instruction.
     int extra;       // Immediate or target or shamt field or offset.
                      // Immediates are sign-extended.
+#ifdef THREADED_DISPATCH
+    OpHandler handler;	// routine that executes it, bound by Decode
+#endif
+};
+
+// The following class holds the instructions of one physical page,
+// decoded the first time each is fetched, together with the length of
+// the straight-line basic block starting at each instruction.  A block
+// runs up to and including the delay slot of the first branch or jump,
+// or to the end of the page.
+
+class DecodedPage {
+  public:
+    DecodedPage();		// nothing decoded yet
+    ~DecodedPage();
+
+    Instruction *instrs;	// InstrsPerPage of them; an opCode of 0
+				// means the slot hasn't been decoded
+    short *blockLength;		// 0 if not known yet, -1 if no block can
+				// start at this slot
 };
 
 // The following class defines the simulated host workstation hardware, as 
@@ -108,7 +162,9 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, bool accurate, int tlbSize, int tlbWays, 
+	    TLBPolicy tlbPolicy, PagePolicy pagePolicy);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -123,8 +179,24 @@ class Machine {
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
-    void OneInstruction(Instruction *instr); 	
-    				// Run one instruction of a user program.
+    bool OneInstruction(); 	// Run one instruction of a user program.
+				// Returns FALSE if it raised an exception.
+    bool RunUntilDue(int budget);
+				// Run up to "budget" instructions, charging
+				// their ticks at the end.  Returns TRUE if
+				// it stopped on an exception.
+    bool ExecuteInstruction(Instruction *instr);
+				// Execute an already fetched instruction.
+				// Returns FALSE if it raised an exception.
+    int RunBlock(int budget);	// Run the basic block at the PC, or at 
+				// most "budget" instructions of it.
+				// Returns how many ran, 0 if no block 
+				// starts there, -1 on an exception.
+    Instruction *FetchInstruction();
+				// Translate the PC and return the decoded
+				// instruction stored there.  Returns NULL
+				// (after raising the exception) if the
+				// translation failed.
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -140,11 +212,29 @@ class Machine {
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+    ExceptionType MemoTranslate(int virtAddr, int* physAddr, int size,
+				MemoType which);
+				// Translate, unless the page is the one
+				// last translated for this kind of access.
+    void InvalidateMemo();	// Forget the last translations; called
+				// whenever the TLB or the page tables
+				// change, and on a context switch.
 
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
 
+    void FlushCounts();		// Charge the current thread with the 
+				// events counted since the last call; 
+				// before the counters are read, and on 
+				// a context switch.
+
+    void InvalidateFrame(int frame);
+				// The contents of physical page "frame"
+				// have been replaced -- forget anything
+				// we decoded from it.  Must be called by
+				// kernel code that loads a frame.
+
     void Debugger();		// invoke the user program debugger
     void DumpState();		// print the user CPU and memory state 
 
@@ -183,10 +273,36 @@ class Machine {
 
 //    TranslationEntry *pageTable;
 	
-	PageTable *pageTable;
-	
+	PageTable *pageTable;		// the frames, and what is in them
+	PageDirectory *pageDirectory;	// the current address space's page
+					// table; set by AddrSpace::RestoreState
 
   private:
+    DecodedPage *DecodedFrame(int frame);
+				// the decoded page for "frame", allocated
+				// on first use
+    Instruction *DecodeSlot(DecodedPage *page, int frame, int slot);
+				// decode an instruction if not done yet
+    int FindBlock(DecodedPage *page, int frame, int slot);
+				// length of the block starting at "slot"
+
+    int memoVpn[NumMemoTypes];	// the page last translated for each kind
+    int memoFrame[NumMemoTypes];	// of access, and its frame; -1 if
+				// there is none
+    int memoSlot[NumMemoTypes];	// and the TLB entry that mapped it
+    int lastSlot;		// the TLB entry the last Translate used
+    DecodedPage **decodedPages;	// for each physical page, the instructions
+				// already decoded from it (NULL until the
+				// first fetch from that page)
+    bool cycleAccurate;		// TRUE to run one instruction, and one 
+				// tick, at a time
+    int pendingTicks;		// instructions run since the last call to
+				// OneTick whose ticks haven't been charged
+    int numLoads, numStores;	// events not yet charged to a thread's
+    int numBranches;		// counters (see FlushCounts)
+    int countedTicks;		// and the user ticks, TLB hits and TLB 
+    int countedHits;		// misses in stats when last charged
+    int countedMisses;
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
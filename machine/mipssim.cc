@@ -23,6 +23,12 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 // 	Simulate the execution of a user-level program on Nachos.
 //	Called by the kernel when the program starts up; never returns.
 //
+//	Unless we are single stepping, tracing instructions or interrupts,
+//	or asked to be cycle accurate, we find out once how long user code
+//	can run before anything is due, run up to there without calling
+//	OneTick (see RunUntilDue), and only then go through OneTick for
+//	the instruction on which something is due.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //----------------------------------------------------------------------
@@ -30,20 +36,141 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
+    bool batch = !cycleAccurate && !TraceIsEnabled('m') 
+				&& !TraceIsEnabled('i');
 
-    if(DebugIsEnabled('m'))
+    if(TraceIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
     for (;;) {
-        OneInstruction(instr);
+	if (batch && !singleStep 
+		&& RunUntilDue(interrupt->UserTicksBeforeDue()))
+	    continue;
+        OneInstruction();
 	interrupt->OneTick();
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::RunUntilDue
+// 	Run up to "budget" user instructions -- as many as can run before
+//	an interrupt or a time-slice yield is due -- a basic block at a 
+//	time where possible, and charge all their ticks at once at the 
+//	end, rather than calling OneTick after each one.
+//
+//	Since nothing is due, the only thing that can break the batch is
+//	an exception: RaiseException charges the instructions before it,
+//	so the kernel sees the right time, and we call OneTick for the
+//	trapping instruction, exactly as Run would.  The kernel may have
+//	scheduled new interrupts, so the budget is no good after that.
+//
+//	Returns TRUE if we stopped because of an exception, FALSE if the
+//	budget was used up (so that the next instruction needs OneTick).
+//----------------------------------------------------------------------
+
+bool
+Machine::RunUntilDue(int budget)
+{
+    int count;
+
+    while (budget > 0) {
+	count = RunBlock(budget);
+	if (count == 0) {		// no block here, single step
+	    if (OneInstruction()) {
+		pendingTicks++;
+		count = 1;
+	    } else
+		count = -1;
+	}
+	if (count < 0) {
+	    interrupt->OneTick();
+	    return TRUE;
+	}
+	budget -= count;
+    }
+    if (pendingTicks > 0) {
+	interrupt->AdvanceUserTicks(pendingTicks);
+	pendingTicks = 0;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Run the straight-line block of instructions starting at the PC,
+//	or at most "budget" instructions of it, translating the PC only 
+//	once.  The ticks of the instructions are left in "pendingTicks",
+//	for RunUntilDue to charge.
+//
+//	Returns the number of instructions run, 0 if there is no block
+//	to run here (for instance, we are in the delay slot of a branch),
+//	or -1 if an instruction raised an exception (it and the rest of 
+//	the block are not counted).
+//----------------------------------------------------------------------
+
+int
+Machine::RunBlock(int budget)
+{
+    ExceptionType exception;
+    DecodedPage *page;
+    int physicalAddress, frame, slot, length, i;
+
+    if (registers[NextPCReg] != registers[PCReg] + 4)
+	return 0;
+
+    exception = MemoTranslate(registers[PCReg], &physicalAddress, 4, 
+				MemoFetch);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return -1;
+    }
+    frame = physicalAddress / PageSize;
+    slot = (physicalAddress % PageSize) / 4;
+    page = DecodedFrame(frame);
+    if (page->blockLength[slot] == 0)
+	page->blockLength[slot] = FindBlock(page, frame, slot);
+    length = min(page->blockLength[slot], budget);
+
+    for (i = 0; i < length; i++) {
+	if (page->instrs[slot + i].opCode == 0)
+	    break;			// stored over since we decoded it
+	if (!ExecuteInstruction(&page->instrs[slot + i]))
+	    return -1;
+	pendingTicks++;
+    }
+    return i;
+}
+
+//----------------------------------------------------------------------
+// Machine::FindBlock
+// 	Return the number of instructions in the basic block that starts
+//	at "slot" of a physical page: up to and including the delay slot
+//	of the first branch or jump, or up to the end of the page.
+//	A branch whose delay slot is on the next page ends the block just
+//	before it.  Returns -1 if the block would be empty.
+//----------------------------------------------------------------------
+
+int
+Machine::FindBlock(DecodedPage *page, int frame, int slot)
+{
+    int i;
+
+    for (i = slot; i < InstrsPerPage; i++) {
+	switch (DecodeSlot(page, frame, i)->opCode) {
+	  case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+	  case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+	  case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	    if (i + 1 == InstrsPerPage)
+		return (i > slot) ? (i - slot) : -1;
+	    DecodeSlot(page, frame, i + 1);
+	    return i + 2 - slot;
+	}
+    }
+    return InstrsPerPage - slot;
+}
 
 //----------------------------------------------------------------------
 // TypeToReg
@@ -67,6 +194,93 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// DecodedPage::DecodedPage
+// 	Nothing in a newly loaded page has been decoded yet.
+//----------------------------------------------------------------------
+
+DecodedPage::DecodedPage()
+{
+    instrs = new Instruction[InstrsPerPage];
+    blockLength = new short[InstrsPerPage];
+    for (int i = 0; i < InstrsPerPage; i++) {
+	instrs[i].opCode = 0;
+	blockLength[i] = 0;
+    }
+}
+
+DecodedPage::~DecodedPage()
+{
+    delete [] instrs;
+    delete [] blockLength;
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodedFrame
+// 	Return the decoded instructions of physical page "frame",
+//	allocating them the first time the page is fetched from.
+//----------------------------------------------------------------------
+
+DecodedPage *
+Machine::DecodedFrame(int frame)
+{
+    if (decodedPages[frame] == NULL)
+	decodedPages[frame] = new DecodedPage();
+    return decodedPages[frame];
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodeSlot
+// 	Return instruction "slot" of a decoded page, decoding it from
+//	main memory if that hasn't been done yet.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::DecodeSlot(DecodedPage *page, int frame, int slot)
+{
+    Instruction *instr = &page->instrs[slot];
+
+    if (instr->opCode == 0) {		// first time through, decode it
+	instr->value = WordToHost(*(unsigned int *) 
+			&mainMemory[frame * PageSize + slot * 4]);
+	instr->Decode();
+    }
+    return instr;
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Fetch and decode the instruction at the PC.
+//
+//	Decoding is done only once per instruction slot of a physical page;
+//	the result is kept in "decodedPages" until the kernel reloads the 
+//	frame (InvalidateFrame) or user code stores into the slot 
+//	(WriteMem).  The PC is still translated on every fetch (through 
+//	the fetch memo), so TLB misses, page faults and the use bits 
+//	behave exactly as before.
+//
+//	Returns NULL if the translation failed; the exception has
+//	already been raised in that case, just as ReadMem would.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::FetchInstruction()
+{
+    ExceptionType exception;
+    int physicalAddress;
+    int frame;
+
+    exception = MemoTranslate(registers[PCReg], &physicalAddress, 4, 
+				MemoFetch);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return NULL;
+    }
+    frame = physicalAddress / PageSize;
+    return DecodeSlot(DecodedFrame(frame), frame, 
+			(physicalAddress % PageSize) / 4);
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -90,21 +304,17 @@ TypeToReg(RegType reg, Instruction *instr)
 //	and the register set.
 //----------------------------------------------------------------------
 
-void
-Machine::OneInstruction(Instruction *instr)
+bool
+Machine::OneInstruction()
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
+    Instruction *instr;
 
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-	return;			// read memory failed. Might be caused due to TLB miss
-    instr->value = raw;
-    instr->Decode();
+    instr = FetchInstruction();
+    if (instr == NULL)
+	return FALSE;		// read memory failed. Might be caused due to TLB miss
 
-    if (DebugIsEnabled('m')) {
+    if (TraceIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
 
        ASSERT(instr->opCode <= MaxOpcode);
@@ -114,6 +324,666 @@ Machine::OneInstruction(Instruction *instr)
        printf("\n");
        }
     
+    return ExecuteInstruction(instr);
+}
+
+#ifdef THREADED_DISPATCH
+//----------------------------------------------------------------------
+// The threaded-code interpreter core
+//	Selected at build time with -DTHREADED_DISPATCH (see SIMFLAGS in
+//	Makefile.common).  Rather than switching on the opcode for every
+//	instruction, Decode binds each instruction to the routine that
+//	executes it, out of "opHandlers" (indexed by the opCode values 
+//	of mipssim.h), and ExecuteInstruction just calls through it.
+//
+//	Each handler does exactly what the matching case of the switch in
+//	ExecuteInstruction does: it updates the registers, and leaves the
+//	next PC and any delayed load in "state".  It returns FALSE if the
+//	instruction raised an exception.
+//----------------------------------------------------------------------
+
+#define HANDLER(name) \
+    static bool name(int *registers, Instruction *instr, ExecState *state)
+
+HANDLER(ExecADD)
+{
+    int sum;
+
+    sum = registers[instr->rs] + registers[instr->rt];
+    if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ sum) & SIGN_BIT)) {
+	machine->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rd] = sum;
+    return TRUE;
+}
+
+HANDLER(ExecADDI)
+{
+    int sum;
+
+    sum = registers[instr->rs] + instr->extra;
+    if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
+	((instr->extra ^ sum) & SIGN_BIT)) {
+	machine->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rt] = sum;
+    return TRUE;
+}
+
+HANDLER(ExecADDIU)
+{
+    registers[instr->rt] = registers[instr->rs] + instr->extra;
+    return TRUE;
+}
+
+HANDLER(ExecADDU)
+{
+    registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
+    return TRUE;
+}
+
+HANDLER(ExecAND)
+{
+    registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
+    return TRUE;
+}
+
+HANDLER(ExecANDI)
+{
+    registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
+    return TRUE;
+}
+
+HANDLER(ExecBEQ)
+{
+    if (registers[instr->rs] == registers[instr->rt])
+	state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecBGEZAL)
+{
+    registers[R31] = registers[NextPCReg] + 4;
+    if (!(registers[instr->rs] & SIGN_BIT))
+	state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecBGEZ)
+{
+    if (!(registers[instr->rs] & SIGN_BIT))
+	state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecBGTZ)
+{
+    if (registers[instr->rs] > 0)
+	state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecBLEZ)
+{
+    if (registers[instr->rs] <= 0)
+	state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecBLTZAL)
+{
+    registers[R31] = registers[NextPCReg] + 4;
+    if (registers[instr->rs] & SIGN_BIT)
+	state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecBLTZ)
+{
+    if (registers[instr->rs] & SIGN_BIT)
+	state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecBNE)
+{
+    if (registers[instr->rs] != registers[instr->rt])
+	state->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecDIV)
+{
+    if (registers[instr->rt] == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
+	registers[HiReg] = registers[instr->rs] % registers[instr->rt];
+    }
+    return TRUE;
+}
+
+HANDLER(ExecDIVU)
+{
+    int tmp;
+    unsigned int rs, rt;
+
+    rs = (unsigned int) registers[instr->rs];
+    rt = (unsigned int) registers[instr->rt];
+    if (rt == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	tmp = rs / rt;
+	registers[LoReg] = (int) tmp;
+	tmp = rs % rt;
+	registers[HiReg] = (int) tmp;
+    }
+    return TRUE;
+}
+
+HANDLER(ExecJAL)
+{
+    registers[R31] = registers[NextPCReg] + 4;
+    state->pcAfter = (state->pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecJ)
+{
+    state->pcAfter = (state->pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+HANDLER(ExecJALR)
+{
+    registers[instr->rd] = registers[NextPCReg] + 4;
+    state->pcAfter = registers[instr->rs];
+    return TRUE;
+}
+
+HANDLER(ExecJR)
+{
+    state->pcAfter = registers[instr->rs];
+    return TRUE;
+}
+
+HANDLER(ExecLB)
+{
+    int tmp, value;
+
+    tmp = registers[instr->rs] + instr->extra;
+    if (!machine->ReadMem(tmp, 1, &value))
+	return FALSE;
+
+    if ((value & 0x80) && (instr->opCode == OP_LB))
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    state->nextLoadReg = instr->rt;
+    state->nextLoadValue = value;
+    return TRUE;
+}
+
+HANDLER(ExecLH)
+{
+    int tmp, value;
+
+    tmp = registers[instr->rs] + instr->extra;
+    if (tmp & 0x1) {
+	machine->RaiseException(AddressErrorException, tmp);
+	return FALSE;
+    }
+    if (!machine->ReadMem(tmp, 2, &value))
+	return FALSE;
+
+    if ((value & 0x8000) && (instr->opCode == OP_LH))
+	value |= 0xffff0000;
+    else
+	value &= 0xffff;
+    state->nextLoadReg = instr->rt;
+    state->nextLoadValue = value;
+    return TRUE;
+}
+
+HANDLER(ExecLUI)
+{
+    TRACE('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
+    registers[instr->rt] = instr->extra << 16;
+    return TRUE;
+}
+
+HANDLER(ExecLW)
+{
+    int tmp, value;
+
+    tmp = registers[instr->rs] + instr->extra;
+    if (tmp & 0x3) {
+	machine->RaiseException(AddressErrorException, tmp);
+	return FALSE;
+    }
+    if (!machine->ReadMem(tmp, 4, &value))
+	return FALSE;
+    state->nextLoadReg = instr->rt;
+    state->nextLoadValue = value;
+    return TRUE;
+}
+
+HANDLER(ExecLWL)
+{
+    int tmp, value;
+
+    tmp = registers[instr->rs] + instr->extra;
+
+    // ReadMem assumes all 4 byte requests are aligned on an even
+    // word boundary.  Also, the little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);
+
+    if (!machine->ReadMem(tmp, 4, &value))
+	return FALSE;
+    if (registers[LoadReg] == instr->rt)
+	state->nextLoadValue = registers[LoadValueReg];
+    else
+	state->nextLoadValue = registers[instr->rt];
+    switch (tmp & 0x3) {
+      case 0:
+	state->nextLoadValue = value;
+	break;
+      case 1:
+	state->nextLoadValue = (state->nextLoadValue & 0xff) | (value << 8);
+	break;
+      case 2:
+	state->nextLoadValue = (state->nextLoadValue & 0xffff) | (value << 16);
+	break;
+      case 3:
+	state->nextLoadValue = (state->nextLoadValue & 0xffffff) | (value << 24);
+	break;
+    }
+    state->nextLoadReg = instr->rt;
+    return TRUE;
+}
+
+HANDLER(ExecLWR)
+{
+    int tmp, value;
+
+    tmp = registers[instr->rs] + instr->extra;
+
+    // ReadMem assumes all 4 byte requests are aligned on an even
+    // word boundary.  Also, the little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);
+
+    if (!machine->ReadMem(tmp, 4, &value))
+	return FALSE;
+    if (registers[LoadReg] == instr->rt)
+	state->nextLoadValue = registers[LoadValueReg];
+    else
+	state->nextLoadValue = registers[instr->rt];
+    switch (tmp & 0x3) {
+      case 0:
+	state->nextLoadValue = (state->nextLoadValue & 0xffffff00) |
+	    ((value >> 24) & 0xff);
+	break;
+      case 1:
+	state->nextLoadValue = (state->nextLoadValue & 0xffff0000) |
+	    ((value >> 16) & 0xffff);
+	break;
+      case 2:
+	state->nextLoadValue = (state->nextLoadValue & 0xff000000)
+	    | ((value >> 8) & 0xffffff);
+	break;
+      case 3:
+	state->nextLoadValue = value;
+	break;
+    }
+    state->nextLoadReg = instr->rt;
+    return TRUE;
+}
+
+HANDLER(ExecMFHI)
+{
+    registers[instr->rd] = registers[HiReg];
+    return TRUE;
+}
+
+HANDLER(ExecMFLO)
+{
+    registers[instr->rd] = registers[LoReg];
+    return TRUE;
+}
+
+HANDLER(ExecMTHI)
+{
+    registers[HiReg] = registers[instr->rs];
+    return TRUE;
+}
+
+HANDLER(ExecMTLO)
+{
+    registers[LoReg] = registers[instr->rs];
+    return TRUE;
+}
+
+HANDLER(ExecMULT)
+{
+    Mult(registers[instr->rs], registers[instr->rt], TRUE,
+	 &registers[HiReg], &registers[LoReg]);
+    return TRUE;
+}
+
+HANDLER(ExecMULTU)
+{
+    Mult(registers[instr->rs], registers[instr->rt], FALSE,
+	 &registers[HiReg], &registers[LoReg]);
+    return TRUE;
+}
+
+HANDLER(ExecNOR)
+{
+    registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
+    return TRUE;
+}
+
+HANDLER(ExecOR)
+{
+    registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
+    return TRUE;
+}
+
+HANDLER(ExecORI)
+{
+    registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
+    return TRUE;
+}
+
+HANDLER(ExecSB)
+{
+    if (!machine->WriteMem((unsigned)
+	    (registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
+	return FALSE;
+    return TRUE;
+}
+
+HANDLER(ExecSH)
+{
+    if (!machine->WriteMem((unsigned)
+	    (registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
+	return FALSE;
+    return TRUE;
+}
+
+HANDLER(ExecSLL)
+{
+    registers[instr->rd] = registers[instr->rt] << instr->extra;
+    return TRUE;
+}
+
+HANDLER(ExecSLLV)
+{
+    registers[instr->rd] = registers[instr->rt] <<
+	(registers[instr->rs] & 0x1f);
+    return TRUE;
+}
+
+HANDLER(ExecSLT)
+{
+    if (registers[instr->rs] < registers[instr->rt])
+	registers[instr->rd] = 1;
+    else
+	registers[instr->rd] = 0;
+    return TRUE;
+}
+
+HANDLER(ExecSLTI)
+{
+    if (registers[instr->rs] < instr->extra)
+	registers[instr->rt] = 1;
+    else
+	registers[instr->rt] = 0;
+    return TRUE;
+}
+
+HANDLER(ExecSLTIU)
+{
+    unsigned int rs, imm;
+
+    rs = registers[instr->rs];
+    imm = instr->extra;
+    if (rs < imm)
+	registers[instr->rt] = 1;
+    else
+	registers[instr->rt] = 0;
+    return TRUE;
+}
+
+HANDLER(ExecSLTU)
+{
+    unsigned int rs, rt;
+
+    rs = registers[instr->rs];
+    rt = registers[instr->rt];
+    if (rs < rt)
+	registers[instr->rd] = 1;
+    else
+	registers[instr->rd] = 0;
+    return TRUE;
+}
+
+HANDLER(ExecSRA)
+{
+    registers[instr->rd] = registers[instr->rt] >> instr->extra;
+    return TRUE;
+}
+
+HANDLER(ExecSRAV)
+{
+    registers[instr->rd] = registers[instr->rt] >>
+	(registers[instr->rs] & 0x1f);
+    return TRUE;
+}
+
+HANDLER(ExecSRL)
+{
+    int tmp;
+
+    tmp = registers[instr->rt];
+    tmp >>= instr->extra;
+    registers[instr->rd] = tmp;
+    return TRUE;
+}
+
+HANDLER(ExecSRLV)
+{
+    int tmp;
+
+    tmp = registers[instr->rt];
+    tmp >>= (registers[instr->rs] & 0x1f);
+    registers[instr->rd] = tmp;
+    return TRUE;
+}
+
+HANDLER(ExecSUB)
+{
+    int diff;
+
+    diff = registers[instr->rs] - registers[instr->rt];
+    if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ diff) & SIGN_BIT)) {
+	machine->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rd] = diff;
+    return TRUE;
+}
+
+HANDLER(ExecSUBU)
+{
+    registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
+    return TRUE;
+}
+
+HANDLER(ExecSW)
+{
+    if (!machine->WriteMem((unsigned)
+	    (registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
+	return FALSE;
+    return TRUE;
+}
+
+HANDLER(ExecSWL)
+{
+    int tmp, value;
+
+    tmp = registers[instr->rs] + instr->extra;
+
+    // The little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);
+
+    if (!machine->ReadMem((tmp & ~0x3), 4, &value))
+	return FALSE;
+    switch (tmp & 0x3) {
+      case 0:
+	value = registers[instr->rt];
+	break;
+      case 1:
+	value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
+					0xffffff);
+	break;
+      case 2:
+	value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
+					0xffff);
+	break;
+      case 3:
+	value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
+					0xff);
+	break;
+    }
+    if (!machine->WriteMem((tmp & ~0x3), 4, value))
+	return FALSE;
+    return TRUE;
+}
+
+HANDLER(ExecSWR)
+{
+    int tmp, value;
+
+    tmp = registers[instr->rs] + instr->extra;
+
+    // The little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);
+
+    if (!machine->ReadMem((tmp & ~0x3), 4, &value))
+	return FALSE;
+    switch (tmp & 0x3) {
+      case 0:
+	value = (value & 0xffffff) | (registers[instr->rt] << 24);
+	break;
+      case 1:
+	value = (value & 0xffff) | (registers[instr->rt] << 16);
+	break;
+      case 2:
+	value = (value & 0xff) | (registers[instr->rt] << 8);
+	break;
+      case 3:
+	value = registers[instr->rt];
+	break;
+    }
+    if (!machine->WriteMem((tmp & ~0x3), 4, value))
+	return FALSE;
+    return TRUE;
+}
+
+HANDLER(ExecSYSCALL)
+{
+    machine->RaiseException(SyscallException, 0);
+    return FALSE;
+}
+
+HANDLER(ExecXOR)
+{
+    registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
+    return TRUE;
+}
+
+HANDLER(ExecXORI)
+{
+    registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
+    return TRUE;
+}
+
+HANDLER(ExecIllegal)
+{
+    machine->RaiseException(IllegalInstrException, 0);
+    return FALSE;
+}
+
+HANDLER(ExecBad)
+{
+    ASSERT(FALSE);		// Decode never produces these opCodes
+    return FALSE;
+}
+
+static OpHandler opHandlers[MaxOpcode + 1] = {
+    ExecBad, ExecADD, ExecADDI, ExecADDIU,
+    ExecADDU, ExecAND, ExecANDI, ExecBEQ,
+    ExecBGEZ, ExecBGEZAL, ExecBGTZ, ExecBLEZ,
+    ExecBLTZ, ExecBLTZAL, ExecBNE, ExecBad,
+    ExecDIV, ExecDIVU, ExecJ, ExecJAL,
+    ExecJALR, ExecJR, ExecLB, ExecLB,
+    ExecLH, ExecLH, ExecLUI, ExecLW,
+    ExecLWL, ExecLWR, ExecBad, ExecMFHI,
+    ExecMFLO, ExecBad, ExecMTHI, ExecMTLO,
+    ExecMULT, ExecMULTU, ExecNOR, ExecOR,
+    ExecORI, ExecBad, ExecSB, ExecSH,
+    ExecSLL, ExecSLLV, ExecSLT, ExecSLTI,
+    ExecSLTIU, ExecSLTU, ExecSRA, ExecSRAV,
+    ExecSRL, ExecSRLV, ExecSUB, ExecSUBU,
+    ExecSW, ExecSWL, ExecSWR, ExecXOR,
+    ExecXORI, ExecSYSCALL, ExecIllegal, ExecIllegal
+};
+#endif // THREADED_DISPATCH
+
+//----------------------------------------------------------------------
+// Machine::ExecuteInstruction
+// 	Execute one decoded instruction, and advance the program counters.
+//
+//	Returns FALSE if the instruction raised an exception (the kernel
+//	has already handled it by the time we return).
+//
+//	"instr" -- the instruction at the PC
+//----------------------------------------------------------------------
+
+bool
+Machine::ExecuteInstruction(Instruction *instr)
+{
+#ifdef THREADED_DISPATCH
+    ExecState state;
+
+    state.pcAfter = registers[NextPCReg] + 4;
+    state.nextLoadReg = 0;
+    state.nextLoadValue = 0;
+    if (!(*instr->handler)(registers, instr, &state))
+	return FALSE;
+    DelayedLoad(state.nextLoadReg, state.nextLoadValue);
+    if (state.pcAfter != registers[NextPCReg] + 4)
+	numBranches++;
+    registers[PrevPCReg] = registers[PCReg];
+    registers[PCReg] = registers[NextPCReg];
+    registers[NextPCReg] = state.pcAfter;
+    return TRUE;
+#else
+    int nextLoadReg = 0; 	
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+				// in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -127,7 +997,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -137,7 +1007,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -232,7 +1102,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -247,10 +1117,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -261,7 +1131,7 @@ Machine::OneInstruction(Instruction *instr)
 	break;
       	
       case OP_LUI:
-	DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
+	TRACE('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
 	registers[instr->rt] = instr->extra << 16;
 	break;
 	
@@ -269,10 +1139,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -286,7 +1156,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -317,7 +1187,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -383,13 +1253,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -459,7 +1329,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -471,7 +1341,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -482,7 +1352,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -501,7 +1371,7 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -512,7 +1382,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -528,12 +1398,12 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -546,7 +1416,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -556,12 +1426,16 @@ Machine::OneInstruction(Instruction *instr)
     
     // Do any delayed load operation
     DelayedLoad(nextLoadReg, nextLoadValue);
+    if (pcAfter != registers[NextPCReg] + 4)	// a branch was taken
+	numBranches++;
     
     // Advance program counters.
     registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
+#endif // THREADED_DISPATCH
 }
 
 //----------------------------------------------------------------------
@@ -623,6 +1497,9 @@ Instruction::Decode()
     	    opCode = OP_UNIMP;
 	}
     }
+#ifdef THREADED_DISPATCH
+    handler = opHandlers[(int) opCode];
+#endif
 }
 
 //----------------------------------------------------------------------
@@ -23,6 +23,30 @@ Statistics::Statistics()
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
 	tlbMiss = tlbHit = 0;
+    numMemoHits = 0;
+    tlbRollovers = numProcessTLB = 0;
+    pageReplacement = NULL;
+    numPageEvictions = numDirtyEvictions = 0;
+    numSwapReads = numSwapWrites = 0;
+    numPagesPrefetched = numZeroFills = 0;
+    numForks = numPagesShared = numCopyOnWrites = 0;
+    numCodePagesShared = 0;
+    numQuotaGrows = numQuotaShrinks = numSuspensions = 0;
+    numFreeFrameHits = numPageoutRuns = 0;
+    numPagesReclaimed = numPagesCleaned = numFrameWaits = 0;
+    pageSize = numPhysPages = 0;
+    superpageSize = 1;
+    numPromotions = numDemotions = numLargeFills = 0;
+    loadMode = NULL;
+    numStartups = startupTicks = 0;
+    startupHostTime = 0;
+    tlbMissHostTime = 0;
+    numTimedMisses = 0;
+    numSpaces = 0;
+    for (int i = 0; i < NumCounters; i++)
+	for (int j = 0; j < MaxCounted; j++)
+	    threadCounters[i][j] = spaceCounters[i][j] = 0;
+    hostStartTime = HostTime();
 }
 
 //----------------------------------------------------------------------
@@ -34,14 +58,178 @@ Statistics::Statistics()
 void
 Statistics::Print()
 {
+    int i;
+
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d, TLB hit %d, miss %d\n", numPageFaults, tlbHit, tlbMiss);
+    if (numPhysPages > 0)
+	printf("Memory: %d pages of %d bytes\n", numPhysPages, pageSize);
+    printf("Paging: faults %d, TLB hit %d, miss %d, memo hits %d\n", 
+	numPageFaults, tlbHit, tlbMiss, numMemoHits);
+    if (numProcessTLB > 0) {
+	printf("TLB: id rollovers %d", tlbRollovers);
+	for (i = 0; i < numProcessTLB && i < MaxProcessStats; i++)
+	    printf(", thread %d hit %d miss %d", processThread[i], 
+		processTLBHits[i], processTLBMisses[i]);
+	printf("\n");
+    }
+    if (pageReplacement != NULL)
+	printf("Replacement: %s, faults %d, evictions %d (%d dirty), "
+	    "prefetched %d, zero-filled %d\n", pageReplacement, 
+	    numPageFaults, numPageEvictions, numDirtyEvictions, 
+	    numPagesPrefetched, numZeroFills);
+    if (loadMode != NULL)
+	printf("Loading: %s, programs %d, startup %d ticks, %.3f ms host, "
+	    "faults %d\n", loadMode, numStartups, startupTicks, 
+	    startupHostTime * 1000, numPageFaults);
+    if (numForks > 0)
+	printf("Fork: forks %d, pages shared %d, copy-on-write faults %d\n",
+	    numForks, numPagesShared, numCopyOnWrites);
+    if (numCodePagesShared > 0)
+	printf("Code sharing: pages found in memory %d\n",
+	    numCodePagesShared);
+    if (numQuotaGrows > 0 || numQuotaShrinks > 0)
+	printf("Quotas: raised %d, lowered %d, suspensions %d\n",
+	    numQuotaGrows, numQuotaShrinks, numSuspensions);
+    if (numPageoutRuns > 0)
+	printf("Pageout: runs %d, pages freed %d (%d written), "
+	    "pages brought into free frames %d, waits for a frame %d\n", 
+	    numPageoutRuns, numPagesReclaimed, numPagesCleaned, 
+	    numFreeFrameHits, numFrameWaits);
+    if (superpageSize > 1)
+	printf("Superpages: %d pages, promotions %d, demotions %d, "
+	    "TLB fills %d\n", superpageSize, numPromotions, numDemotions,
+	    numLargeFills);
+    if (numSwapReads > 0 || numSwapWrites > 0)
+	printf("Swap: page reads %d, writes %d\n", numSwapReads, 
+	    numSwapWrites);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+    PrintCounters();
+    PrintSpeed();
+}
+
+//----------------------------------------------------------------------
+// Statistics::ThreadCount, Statistics::SpaceCount
+// 	Return one counter of a thread, or of an address space; 0 if 
+//	there is no such counter, or no such thread or address space is
+//	counted.
+//----------------------------------------------------------------------
+
+int
+Statistics::ThreadCount(CounterType which, int threadId)
+{
+    if (which < 0 || which >= NumCounters || threadId < 0 
+		|| threadId >= MaxCounted)
+	return 0;
+    return threadCounters[which][threadId];
+}
+
+int
+Statistics::SpaceCount(CounterType which, int spaceId)
+{
+    if (which < 0 || which >= NumCounters || spaceId < 0 
+		|| spaceId >= MaxCounted)
+	return 0;
+    return spaceCounters[which][spaceId];
+}
+
+//----------------------------------------------------------------------
+// Statistics::ClearThreadCounters
+// 	Start the counters of a thread id afresh, because a new thread 
+//	has been given it.  (Those of address spaces are never reused.)
+//----------------------------------------------------------------------
+
+void
+Statistics::ClearThreadCounters(int threadId)
+{
+    for (int i = 0; i < NumCounters; i++)
+	threadCounters[i][threadId] = 0;
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintCounters
+// 	Print the counters of each thread (that is still around, or was
+//	the last to have its id) and each address space, leaving out 
+//	those with nothing counted.
+//----------------------------------------------------------------------
+
+static void
+PrintCounterRow(const char *kind, int id, int counters[][MaxCounted])
+{
+    int i;
+
+    for (i = 0; i < NumCounters; i++)
+	if (counters[i][id] != 0)
+	    break;
+    if (i == NumCounters)
+	return;
+    printf("Counters: %s %d: instructions %d, loads %d, stores %d, "
+	"branches %d, TLB hits %d, misses %d, page faults %d, syscalls %d, "
+	"switches %d\n", kind, id, counters[InstrCounter][id], 
+	counters[LoadCounter][id], counters[StoreCounter][id], 
+	counters[BranchCounter][id], counters[TLBHitCounter][id], 
+	counters[TLBMissCounter][id], counters[PageFaultCounter][id], 
+	counters[SyscallCounter][id], counters[SwitchCounter][id]);
+}
+
+void
+Statistics::PrintCounters()
+{
+    int i;
+
+    for (i = 0; i < MaxCounted; i++)
+	PrintCounterRow("thread", i, threadCounters);
+    for (i = 0; i < numSpaces && i < MaxCounted; i++)
+	PrintCounterRow("space", i, spaceCounters);
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordProcessTLB
+// 	Keep the TLB hits and misses of a user program that has exited,
+//	to print them separately.
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordProcessTLB(int threadId, int hits, int misses)
+{
+    if (numProcessTLB < MaxProcessStats) {
+	processThread[numProcessTLB] = threadId;
+	processTLBHits[numProcessTLB] = hits;
+	processTLBMisses[numProcessTLB] = misses;
+    }
+    numProcessTLB++;
+}
+
+//----------------------------------------------------------------------
+// Statistics::PrintSpeed
+// 	Print how fast the simulator ran on the host: the number of user 
+//	instructions executed per second of host time since startup, and
+//	whether this is a release build (tracing compiled out); then the 
+//	page faults per host second, and the host time a TLB miss took to
+//	handle, on average over the misses that were timed.
+//----------------------------------------------------------------------
+
+void
+Statistics::PrintSpeed()
+{
+    double seconds = HostTime() - hostStartTime;
+#ifdef RELEASE
+    const char *build = "release";
+#else
+    const char *build = "debug";
+#endif
+
+    printf("Simulator: host time %.3f seconds, %.0f user instructions/second, %s build\n",
+	seconds, (seconds > 0) ? (userTicks / UserTick) / seconds : 0.0, 
+	build);
+    printf("Host: %.0f page faults/second, %.3f microseconds/TLB miss\n",
+	(seconds > 0) ? numPageFaults / seconds : 0.0,
+	(numTimedMisses > 0) ? tlbMissHostTime * 1000000 / numTimedMisses 
+	    : 0.0);
 }
 
 void
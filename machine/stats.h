@@ -13,6 +13,30 @@
 
 #include "copyright.h"
 
+#define MaxProcessStats	64	// programs whose own statistics are kept
+#define TLBMissSample	64	// time the handling of one TLB miss in 
+				// this many
+
+// Counters kept for each thread and each address space, to tell which
+// program in a mix did what.  Each counter is one array, indexed by 
+// thread id or by address space id, so counting an event touches one 
+// word.  The events of the running user program are charged in bulk
+// (see Machine::FlushCounts).  The order is that of the Counter codes
+// in syscall.h.
+
+enum CounterType { InstrCounter,	// user instructions retired
+		   LoadCounter,		// loads from user memory
+		   StoreCounter,	// stores to it
+		   BranchCounter,	// branches and jumps taken
+		   TLBHitCounter, TLBMissCounter,
+		   PageFaultCounter,
+		   SyscallCounter,
+		   SwitchCounter,	// times switched to
+		   NumCounters };
+
+#define MaxCounted	128	// thread ids (cf. MAX_ALLOWED_THREAD), and
+				// address spaces, that are counted
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -40,10 +64,82 @@ class Statistics {
 
     void Print();		// print collected statistics
 	void PrintTicks();
+    void PrintSpeed();		// print host time and instructions/second
 	
 	//below implemented by zz
 	int tlbMiss;
 	int tlbHit;
+    int numMemoHits;		// translations the last one for the same
+				// kind of access gave (counted as TLB 
+				// hits too)
+    int tlbRollovers;		// times the TLB ran out of address space
+				// ids, and was flushed
+    void RecordProcessTLB(int threadId, int hits, int misses);
+				// the TLB hits and misses of a program
+				// that has exited
+    int numProcessTLB;		// how many have been recorded; only the
+    int processThread[MaxProcessStats];	// first MaxProcessStats 
+    int processTLBHits[MaxProcessStats];	// are kept
+    int processTLBMisses[MaxProcessStats];
+
+    char *pageReplacement;	// the page replacement policy, NULL if 
+				// there is no demand paging
+    int numPageEvictions;	// pages replaced to make room for another
+    int numDirtyEvictions;	// of those, pages that had been modified
+    int numSwapReads;		// pages read back from a swap area
+    int numSwapWrites;		// pages written out to a swap area
+    int numPagesPrefetched;	// pages loaded along with a faulting one
+    int numZeroFills;		// pages that were just cleared, having
+				// nothing in the executable
+    int numForks;		// address spaces created by Fork
+    int numPagesShared;		// resident pages a child got by mapping
+				// its parent's frame, not copying it
+    int numCopyOnWrites;	// writes to a copy-on-write page
+    int numCodePagesShared;	// code pages mapped from a frame already
+				// holding them for the same program
+    int numQuotaGrows;		// frame quotas raised, for faulting often
+    int numQuotaShrinks;	// and lowered, for faulting rarely
+    int numSuspensions;		// programs suspended by load control
+    int numFreeFrameHits;	// pages brought into a frame that was free
+    int numPageoutRuns;		// times the pageout daemon was woken
+    int numPagesReclaimed;	// pages it freed,
+    int numPagesCleaned;	// pages it wrote back
+    int numFrameWaits;		// times a fault waited for a free frame
+    int pageSize;		// the memory configuration, 0 if there 
+    int numPhysPages;		// is no simulated memory
+    int superpageSize;		// pages in a superpage, 1 if none
+    int numPromotions;		// groups of pages made superpages
+    int numDemotions;		// and split up again
+    int numLargeFills;		// TLB misses filled with a superpage
+
+    char *loadMode;		// how programs were loaded, NULL if none 
+				// was
+    int numStartups;		// programs started
+    int startupTicks;		// simulated time, and host time, spent 
+    double startupHostTime;	// getting them ready to run
+
+    double tlbMissHostTime;	// host time spent handling the TLB misses
+    int numTimedMisses;		// that were timed (one in TLBMissSample)
+
+    void Count(CounterType which, int threadId, int spaceId, int n) {
+	threadCounters[which][threadId] += n;
+	if (spaceId >= 0 && spaceId < MaxCounted)
+	    spaceCounters[which][spaceId] += n;
+    }				// count "n" events for a thread, and for
+				// its address space (-1 if none)
+    int ThreadCount(CounterType which, int threadId);
+    int SpaceCount(CounterType which, int spaceId);
+				// a counter, 0 if it isn't kept
+    void ClearThreadCounters(int threadId);
+				// a new thread has the id
+    void PrintCounters();	// print the counters that are not all 0
+    int numSpaces;		// address spaces created; the first 
+				// MaxCounted are counted
+    int threadCounters[NumCounters][MaxCounted];
+    int spaceCounters[NumCounters][MaxCounted];
+
+    double hostStartTime;	// host time when Nachos started, to report
+				// how fast the simulator ran
 };
 
 // Constants used to reflect the relative time an operation would
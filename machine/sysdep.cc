@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -242,6 +243,22 @@ Tell(int fd)
 }
 
 
+//----------------------------------------------------------------------
+// FileId
+// 	Return a number identifying the UNIX file open as "fd" (its inode),
+//	the same however many times, and by whatever name, it is opened.
+//----------------------------------------------------------------------
+
+int 
+FileId(int fd)
+{
+    struct stat status;
+
+    if (fstat(fd, &status) < 0)
+	return -1;
+    return (int) status.st_ino;
+}
+
 //----------------------------------------------------------------------
 // Close
 // 	Close a file.  Abort on error.
@@ -438,6 +455,22 @@ Exit(int exitCode)
     exit(exitCode);
 }
 
+//----------------------------------------------------------------------
+// HostTime
+// 	Return the wall-clock time of the host, in seconds.  Only used to
+//	measure how fast the simulation runs; simulated time is kept
+//	by the interrupt emulation.
+//----------------------------------------------------------------------
+
+double
+HostTime()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 //----------------------------------------------------------------------
 // RandomInit
 // 	Initialize the pseudo-random number generator.  We use the
@@ -501,3 +534,42 @@ DeallocBoundedArray(char *ptr, int size)
     mprotect(ptr + size, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
     delete [] (ptr - pgSize);
 }
+
+//----------------------------------------------------------------------
+// AllocMemory
+// 	Return a zeroed region of "size" bytes, mapped anonymously, so that
+//	the host only gives it memory as pages of it are touched.  Where
+//	the host has them, ask for huge pages, to save its TLB.
+//
+//	"size" -- amount of space needed (in bytes)
+//----------------------------------------------------------------------
+
+char *
+AllocMemory(int size)
+{
+    char *ptr = (char *) mmap(NULL, size, PROT_READ | PROT_WRITE, 
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ptr == (char *) MAP_FAILED) {
+	perror("mmap");
+	Abort();
+    }
+#ifdef MADV_HUGEPAGE
+    madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+    return ptr;
+}
+
+//----------------------------------------------------------------------
+// FreeMemory
+// 	Give back a region from AllocMemory.
+//
+//	"ptr" -- the region
+//	"size" -- its size (in bytes)
+//----------------------------------------------------------------------
+
+void
+FreeMemory(char *ptr, int size)
+{
+    munmap(ptr, size);
+}
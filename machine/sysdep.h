@@ -27,6 +27,7 @@ extern void WriteFile(int fd, char *buffer, int nBytes);
 extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern void Close(int fd);
+extern int FileId(int fd);
 extern bool Unlink(char *name);
 
 // Interprocess communication operations, for simulating the network
@@ -46,6 +47,9 @@ extern void Delay(int seconds);
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
+// Host wall-clock time in seconds, for measuring the simulator itself
+extern double HostTime();
+
 // Initialize the pseudo random number generator
 extern void RandomInit(unsigned seed);
 extern int Random();
@@ -55,6 +59,11 @@ extern int Random();
 extern char *AllocBoundedArray(int size);
 extern void DeallocBoundedArray(char *p, int size);
 
+// Allocate, de-allocate a large zeroed region, that only takes up host
+// memory as it is touched
+extern char *AllocMemory(int size);
+extern void FreeMemory(char *p, int size);
+
 // Other C library routines that are used by Nachos.
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
@@ -33,6 +33,7 @@
 #include "machine.h"
 #include "addrspace.h"
 #include "system.h"
+#include "synch.h"
 
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  These end up
@@ -91,9 +92,9 @@ Machine::ReadMem(int addr, int size, int *value)
     ExceptionType exception;
     int physicalAddress;
     
-    DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
+    TRACE('a', "Reading VA 0x%x, size %d\n", addr, size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
+    exception = MemoTranslate(addr, &physicalAddress, size, MemoLoad);
     if (exception != NoException) {
 		machine->RaiseException(exception, addr);
 		return FALSE;
@@ -116,8 +117,9 @@ Machine::ReadMem(int addr, int size, int *value)
 
       default: ASSERT(FALSE);
     }
+    numLoads++;
     
-    DEBUG('a', "\tvalue read = %8.8x\n", *value);
+    TRACE('a', "\tvalue read = %8.8x\n", *value);
     return (TRUE);
 }
 
@@ -139,14 +141,26 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    DecodedPage *page;
      
-    DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
+    TRACE('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
+    exception = MemoTranslate(addr, &physicalAddress, size, MemoStore);
     if (exception != NoException) {
 	machine->RaiseException(exception, addr);
 	return FALSE;
     }
+
+    // storing over an instruction we decoded -- decode it again next 
+    // time, and find the blocks of the page again since it may no longer
+    // be (or now be) a branch
+    page = decodedPages[physicalAddress / PageSize];
+    if ((page != NULL) && (page->instrs[(physicalAddress % PageSize) / 4]
+				.opCode != 0)) {
+	page->instrs[(physicalAddress % PageSize) / 4].opCode = 0;
+	for (int i = 0; i < InstrsPerPage; i++)
+	    page->blockLength[i] = 0;
+    }
     switch (size) {
       case 1:
 	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
@@ -164,6 +178,7 @@ Machine::WriteMem(int addr, int size, int value)
 	
       default: ASSERT(FALSE);
     }
+    numStores++;
     
     return TRUE;
 }
@@ -186,16 +201,15 @@ Machine::WriteMem(int addr, int size, int value)
 ExceptionType
 Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 {
-    int i;
     unsigned int vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
 
-    DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
+    TRACE('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
 // check for alignment errors
     if (((size == 4) && (virtAddr & 0x3)) || ((size == 2) && (virtAddr & 0x1))){
-	DEBUG('a', "alignment problem at %d, size %d!\n", virtAddr, size);
+	TRACE('a', "alignment problem at %d, size %d!\n", virtAddr, size);
 	return AddressErrorException;
     }
     
@@ -208,6 +222,10 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 // from the virtual address
     vpn = (unsigned) virtAddr / PageSize;
     offset = (unsigned) virtAddr % PageSize;
+    if (vpn >= MaxVirtualPages) {
+	TRACE('a', "virtual page # %d too large!\n", vpn);
+	return AddressErrorException;
+    }
     
     if (tlb == NULL) {		// => page table => vpn is index into table
 		entry = pageTable->getPage(currentThread->threadId,vpn);
@@ -215,16 +233,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 			return PageFaultException;
 		}
     } else {					// using tlb
-        for (entry = NULL, i = 0; i < TLBSize; i++) {
-    	    if (tlb->tlbTable[i].valid && (tlb->tlbTable[i].threadId == currentThread->threadId) && (tlb->tlbTable[i].virtualPage == vpn)) {
-				entry = &(tlb->tlbTable[i]);			// FOUND!
-				tlb->hitRecord[i]++;					// tlb hit!
-				stats->tlbHit++;
-				break;
-			}
-		}
-		if (entry == NULL) {				// not found
-			DEBUG('a', "*** no valid TLB entry found for this virtual page!\n");
+		entry = tlb->Lookup(vpn);
+		if (entry != NULL) {			// tlb hit!
+			lastSlot = entry - tlb->tlbTable;
+			stats->tlbHit++;
+		} else {				// not found
+			TRACE('a', "*** no valid TLB entry found for this virtual page!\n");
 			stats->tlbMiss++;
 			return TLBMissException;		// really, this is a TLB fault,
 							// the page may be in memory,
@@ -233,54 +247,299 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
-	DEBUG('a', "%d mapped read-only at %d in TLB!\n", virtAddr, i);
+	TRACE('a', "%d mapped read-only!\n", virtAddr);
 	return ReadOnlyException;
     }
-    pageFrame = entry->physicalPage;
+    pageFrame = entry->physicalPage + (vpn - entry->virtualPage);
+					// not the first page of a superpage
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
-	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
+    if (pageFrame >= (unsigned) NumPhysPages) { 
+	TRACE('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 	return BusErrorException;
     }
     entry->use = TRUE;		// set the use, dirty bits
     if (writing)
 	entry->dirty = TRUE;
+    if (pageTable != NULL) {	// and for the frame, for replacement
+	entry = &pageTable->pgTableEntry[pageFrame];
+	entry->use = TRUE;
+	if (writing)
+	    entry->dirty = TRUE;
+    }
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
-    DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+    TRACE('a', "phys addr = 0x%x\n", *physAddr);
     return NoException;
 }
 
+//----------------------------------------------------------------------
+// Machine::MemoTranslate
+// 	Translate a virtual address, as Translate does, but remember the
+//	page and frame of the last translation for each kind of access 
+//	(instruction fetch, load, store), and skip Translate when the 
+//	next access of that kind is to the same page.  Sequential fetches
+//	and walks through an array mostly stay on one page.
+//
+//	A remembered translation is the one the TLB (or page table) would
+//	give, since the memos are thrown away whenever either changes 
+//	(InvalidateMemo).  A store is only remembered once it has set the
+//	dirty bits, so the fast path need only do what a hit does for the
+//	replacement policies: tell the TLB its entry was used, as Lookup 
+//	would (or count the frame's hit, as getPage would, without a TLB),
+//	and set the use bits.
+//
+//	"virtAddr" -- the virtual address to translate
+//	"physAddr" -- the place to store the physical address
+//	"size" -- the amount of memory being read or written
+//	"which" -- the kind of access
+//----------------------------------------------------------------------
+
+ExceptionType
+Machine::MemoTranslate(int virtAddr, int* physAddr, int size, MemoType which)
+{
+    int vpn = (unsigned) virtAddr / PageSize;
+    ExceptionType exception;
+
+    if ((vpn == memoVpn[which]) && ((virtAddr & (size - 1)) == 0)) {
+	*physAddr = memoFrame[which] * PageSize + (unsigned) virtAddr % PageSize;
+	if (tlb != NULL) {		// it would have hit in the TLB
+	    tlb->Touch(memoSlot[which]);
+	    tlb->tlbTable[memoSlot[which]].use = TRUE;
+	    stats->tlbHit++;
+	} else
+	    pageTable->hitRecord[memoFrame[which]]++;
+	pageTable->pgTableEntry[memoFrame[which]].use = TRUE;
+	stats->numMemoHits++;
+	return NoException;
+    }
+    exception = Translate(virtAddr, physAddr, size, which == MemoStore);
+    if (exception == NoException) {
+	memoVpn[which] = vpn;
+	memoFrame[which] = *physAddr / PageSize;
+	memoSlot[which] = lastSlot;
+    }
+    return exception;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateMemo
+// 	Forget the last translation of every kind of access.
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateMemo()
+{
+    for (int i = 0; i < NumMemoTypes; i++)
+	memoVpn[i] = memoFrame[i] = memoSlot[i] = -1;
+}
+
 
 //	TLBbuffer implemented by zz
-TLBuffer::TLBuffer(int bfSize){
+//	"bfSize" entries in sets of "assoc" ways, replaced by "repl"
+TLBuffer::TLBuffer(int bfSize, int assoc, TLBPolicy repl){
 	int i;
+	ASSERT(assoc > 0 && bfSize % assoc == 0);
+	ASSERT(repl != TLBPseudoLRU || (assoc <= 32 && (assoc & (assoc - 1)) == 0));
 	tlbTable = new TranslationEntry[bfSize];
 	hitRecord = new int[bfSize];
 	bufferSize = bfSize;
+	ways = assoc;
+	numSets = bfSize / assoc;
+	policy = repl;
 	for (i = 0; i < bfSize; i++) {
 		tlbTable[i].valid = FALSE;
 		hitRecord[i] = 0;
 	}
+	useClock = 0;
+	plruBits = new unsigned int[numSets];
+	clockHand = new int[numSets];
+	for (i = 0; i < numSets; i++) {
+		plruBits[i] = 0;
+		clockHand[i] = 0;
+	}
+	currentASID = 0;
+	generation = 0;
+	nextASID = 0;
 }
 
 TLBuffer::~TLBuffer(){
-	delete tlbTable;
-	delete hitRecord;
+	delete [] tlbTable;
+	delete [] hitRecord;
+	delete [] plruBits;
+	delete [] clockHand;
+}
+
+TranslationEntry *
+TLBuffer::Lookup(int vpn){
+	int i, first = (vpn % numSets) * ways;
+	int group = vpn - vpn % superpageSize;
+
+	for (i = first; i < first + ways; i++) {
+		if (tlbTable[i].valid && (tlbTable[i].virtualPage == vpn) 
+				&& !tlbTable[i].large && (tlbTable[i].asid == currentASID)) {
+			Touch(i);
+			return &tlbTable[i];
+		}
+	}
+	if (superpageSize == 1)
+		return NULL;
+	first = LargeSet(vpn);
+	for (i = first; i < first + ways; i++) {
+		if (tlbTable[i].valid && tlbTable[i].large && (tlbTable[i].virtualPage == group)
+				&& (tlbTable[i].asid == currentASID)) {
+			Touch(i);
+			return &tlbTable[i];
+		}
+	}
+	return NULL;
+}
+
+int
+TLBuffer::LargeSet(int vpn){
+	return ((vpn / superpageSize) % numSets) * ways;
+}
+
+// drop the entry for a page that is leaving memory, if it is cached;
+// only its set need be looked at.  An id from an earlier generation 
+// has nothing cached any more.
+void
+TLBuffer::Invalidate(int asid, int asidGeneration, int vpn){
+	int i, first = (vpn % numSets) * ways;
+	machine->InvalidateMemo();
+	if (asidGeneration != generation)
+		return;
+	for (i = first; i < first + ways; i++) {
+		if ((tlbTable[i].virtualPage == vpn) && !tlbTable[i].large && (tlbTable[i].asid == asid))
+			tlbTable[i].valid = FALSE;
+	}
+	if (superpageSize == 1)
+		return;
+	first = LargeSet(vpn);			// and the superpage holding it
+	for (i = first; i < first + ways; i++) {
+		if (tlbTable[i].large && (tlbTable[i].virtualPage == vpn - vpn % superpageSize) 
+				&& (tlbTable[i].asid == asid))
+			tlbTable[i].valid = FALSE;
+	}
+}
+
+// make the address space whose id is "*asid" the current one.  If the
+// id is from an earlier generation (or it never had one), hand out a 
+// new one, starting a new generation when they have all been used.
+void
+TLBuffer::Activate(int *asid, int *asidGeneration){
+	if (*asidGeneration != generation) {
+		if (nextASID == NumASIDs) {
+			Flush();
+			generation++;
+			nextASID = 0;
+			stats->tlbRollovers++;
+		}
+		*asid = nextASID++;
+		*asidGeneration = generation;
+	}
+	currentASID = *asid;
+	machine->InvalidateMemo();
+}
+
+void
+TLBuffer::Flush(){
+	int i;
+	machine->InvalidateMemo();
+	for (i = 0; i < bufferSize; i++)
+		tlbTable[i].valid = FALSE;
+}
+
+void
+TLBuffer::Touch(int index){
+	int set, way, bit, node;
+	switch (policy) {
+	  case TLBLeastFrequent:
+		hitRecord[index]++;
+		break;
+	  case TLBLeastRecent:
+		hitRecord[index] = ++useClock;
+		break;
+	  case TLBPseudoLRU:
+		// walk down to the way, pointing each node at the other half
+		set = index / ways;
+		way = index % ways;
+		node = 1;
+		for (bit = ways / 2; bit > 0; bit /= 2) {
+			if (way & bit) {
+				plruBits[set] &= ~(1 << node);
+				node = 2 * node + 1;
+			} else {
+				plruBits[set] |= (1 << node);
+				node = 2 * node;
+			}
+		}
+		break;
+	  case TLBClock:
+		hitRecord[index] = 1;
+		break;
+	  case TLBRandom:
+		break;
+	}
+}
+
+int
+TLBuffer::Victim(int set){
+	int first = set * ways;
+	int i, victim, bit, node;
+
+	for (i = first; i < first + ways; i++) {	// a free entry first
+		if (!tlbTable[i].valid)
+			return i;
+	}
+	switch (policy) {
+	  case TLBLeastFrequent:
+	  case TLBLeastRecent:
+		victim = first;
+		for (i = first + 1; i < first + ways; i++) {
+			if (hitRecord[i] < hitRecord[victim])
+				victim = i;
+		}
+		return victim;
+	  case TLBPseudoLRU:
+		// follow the pointers down to the least recently used half
+		victim = 0;
+		node = 1;
+		for (bit = ways / 2; bit > 0; bit /= 2) {
+			if (plruBits[set] & (1 << node)) {
+				victim |= bit;
+				node = 2 * node + 1;
+			} else
+				node = 2 * node;
+		}
+		return first + victim;
+	  case TLBRandom:
+		return first + Random() % ways;
+	  case TLBClock:
+		// skip (and clear) entries used since the hand last passed
+		for (;;) {
+			victim = first + clockHand[set];
+			clockHand[set] = (clockHand[set] + 1) % ways;
+			if (hitRecord[victim] == 0)
+				return victim;
+			hitRecord[victim] = 0;
+		}
+	}
+	return first;
 }
 
 // swap the TranslationEntry from pageTable to TLB when tlb miss
 // implemented by zz
 void
 TLBuffer::Swap(){
-	int missingVAddr,swapIndex,i,minHit;
+	int missingVAddr,swapIndex;
 	int vpn;
 	TranslationEntry *entry;
 	
+	machine->InvalidateMemo();		// the entry replaced goes
 	missingVAddr = machine->ReadRegister(BadVAddrReg);
-	vpn =  missingVAddr / PageSize;
+	vpn =  (unsigned) missingVAddr / PageSize;
 	
 	// get the page from the page table
 	entry = machine->pageTable->getPage(currentThread->threadId,vpn);
@@ -293,29 +552,95 @@ TLBuffer::Swap(){
 			ASSERT(FALSE);
 		}
 	}
-	swapIndex = 0;
-	minHit = hitRecord[0];
-	for(i = 0; i < bufferSize; i++){
-		if(!tlbTable[i].valid) {
-			swapIndex = i;
-			break;
-		}
-		if(hitRecord[i] < minHit) {
-			minHit = hitRecord[i];
-			swapIndex = i;
-		}
+	if (entry->large) {			// one entry for the superpage
+		swapIndex = Victim(LargeSet(vpn) / ways);
+		tlbTable[swapIndex] = *(entry);
+		tlbTable[swapIndex].virtualPage = vpn - vpn % superpageSize;
+		tlbTable[swapIndex].physicalPage = entry->physicalPage - vpn % superpageSize;
+		stats->numLargeFills++;
+	} else {
+		swapIndex = Victim(vpn % numSets);
+		tlbTable[swapIndex] = *(entry);
 	}
-	tlbTable[swapIndex] = *(entry);
-	hitRecord[swapIndex] = 1;
+	tlbTable[swapIndex].asid = currentASID;
+	if (policy == TLBLeastFrequent)
+		hitRecord[swapIndex] = 1;
+	else
+		Touch(swapIndex);
 }
 
 
-//	a page table implemented by zz
-PageTable::PageTable(int bfSize){
+//	a two-level page table, for "maxPages" virtual pages
+PageDirectory::PageDirectory(int maxPages){
+	int i;
+	numTables = divRoundUp(maxPages, PageTableSize);
+	tables = new int *[numTables];
+	for (i = 0; i < numTables; i++)
+		tables[i] = NULL;
+}
+
+PageDirectory::~PageDirectory(){
+	int i;
+	for (i = 0; i < numTables; i++)
+		delete [] tables[i];
+	delete [] tables;
+}
+
+int
+PageDirectory::Find(int vpn){
+	int *table;
+	if (vpn < 0 || (vpn >> PageTableBits) >= numTables)
+		return -1;
+	table = tables[vpn >> PageTableBits];
+	if (table == NULL)
+		return -1;
+	return table[vpn & (PageTableSize - 1)];
+}
+
+void
+PageDirectory::Set(int vpn, int m){
+	int **table = &tables[vpn >> PageTableBits];
 	int i;
+	ASSERT(vpn >= 0 && (vpn >> PageTableBits) < numTables);
+	if (*table == NULL) {
+		if (m == -1)
+			return;
+		*table = new int[PageTableSize];
+		for (i = 0; i < PageTableSize; i++)
+			(*table)[i] = -1;
+	}
+	(*table)[vpn & (PageTableSize - 1)] = m;
+}
+
+
+//	a page table implemented by zz
+//	It is inverted: one entry per physical frame, holding whether the 
+//	frame is in use and its use and dirty bits.  Which pages are in a 
+//	frame is kept as mappings <threadId, virtualPage> -> frame, each
+//	indexed in the PageDirectory of the thread's address space.  A 
+//	frame usually has one mapping; after a Fork it can
+//	have several, read-only until one of them writes (see CopyOnWrite),
+//	or, for pure code, one per address space running the program (see
+//	Bring).
+PageTable::PageTable(int bfSize, PagePolicy repl){
+	int i, buckets;
+	static char *policyNames[] = { "least frequent", "clock", 
+			"second chance", "WSClock", "aging" };
 	entrySize = bfSize;
+	policy = repl;
+	stats->pageReplacement = policyNames[repl];
 	pgTableEntry = new TranslationEntry[bfSize];
 	hitRecord = new int[bfSize];
+	lastUse = new int[bfSize];
+	history = new int[bfSize];
+	frameMap = new int[bfSize];
+	refCount = new int[bfSize];
+	copyOnWrite = new bool[bfSize];
+	cacheFile = new int[bfSize];
+	cacheOffset = new int[bfSize];
+	cacheNext = new int[bfSize];
+	eligible = new bool[bfSize];
+	busy = new bool[bfSize];
 	for (i = 0; i < bfSize; i++) {
 		pgTableEntry[i].valid = FALSE;
 		pgTableEntry[i].use = FALSE;
@@ -323,114 +648,943 @@ PageTable::PageTable(int bfSize){
 		pgTableEntry[i].readOnly = FALSE;
 		pgTableEntry[i].physicalPage = i;
 		hitRecord[i] = 0;
+		lastUse[i] = 0;
+		history[i] = 0;
+		frameMap[i] = -1;
+		refCount[i] = 0;
+		copyOnWrite[i] = FALSE;
+		cacheFile[i] = -1;
+		cacheOffset[i] = 0;
+		cacheNext[i] = -1;
+		eligible[i] = TRUE;
+		busy[i] = FALSE;
+	}
+	restricted = FALSE;
+	// only aging looks at the time (the largest tick count means never)
+	nextAging = (policy == PageAging) ? AgingInterval : 0x7fffffff;
+	suspended = new List;
+	lowWater = max(1, bfSize / 8);
+	highWater = max(lowWater + 1, bfSize / 4);
+	pageoutWanted = NULL;		// no daemon
+	pageoutWaiting = FALSE;
+	numBusy = 0;
+	frameFreed = new Semaphore("frame freed", 0);
+	frameWaiters = 0;
+	hand = 0;
+	numFree = bfSize;
+
+	mapSize = bfSize;
+	mapEntry = new TranslationEntry[mapSize];
+	mapNext = new int[mapSize];
+	for (i = 0; i < mapSize; i++) {
+		mapEntry[i].valid = FALSE;
+		mapNext[i] = i + 1;
 	}
+	mapNext[mapSize - 1] = -1;
+	freeMap = 0;
+
+	for (buckets = 1; buckets < bfSize; buckets *= 2)
+		;
+	hashMask = buckets - 1;
+	cacheBucket = new int[buckets];
+	for (i = 0; i < buckets; i++)
+		cacheBucket[i] = -1;
 }
 
 PageTable::~PageTable(){
-	delete pgTableEntry;
-	delete hitRecord;
+	delete [] pgTableEntry;
+	delete [] hitRecord;
+	delete [] lastUse;
+	delete [] history;
+	delete [] frameMap;
+	delete [] refCount;
+	delete [] copyOnWrite;
+	delete [] mapEntry;
+	delete [] mapNext;
+	delete [] cacheFile;
+	delete [] cacheOffset;
+	delete [] cacheBucket;
+	delete [] cacheNext;
+	delete [] eligible;
+	delete [] busy;
+	delete suspended;
+	delete pageoutWanted;
+	delete frameFreed;
 }
 
+// the current thread's page table is the machine's, so translating 
+// for it doesn't depend on how many threads there are
+PageDirectory *
+PageTable::Directory(int threadId){
+	PageDirectory *directory;
+	if (threadId == currentThread->threadId)
+		directory = machine->pageDirectory;
+	else
+		directory = SpaceOf(threadId)->directory;
+	ASSERT(directory != NULL);	// RestoreState installs it
+	return directory;
+}
+
+AddrSpace *
+PageTable::SpaceOf(int threadId){
+	Thread *thread = Thread::getThread(threadId);
+	ASSERT(thread != NULL && thread->space != NULL);
+	return thread->space;
+}
+
+int
+PageTable::FindMapping(int threadId, int vpn){
+	return Directory(threadId)->Find(vpn);
+}
+
+// the mapping of page "vpn" of a thread, looked up in its directory,
+// NULL if the page isn't in memory
 TranslationEntry *
 PageTable::getPage(int threadId, int vpn){
+	int m = FindMapping(threadId, vpn);
+	if (m == -1)
+		return NULL;
+	hitRecord[mapEntry[m].physicalPage]++;
+	return &mapEntry[m];
+}
+
+// mix both halves of the key, so that the same offset in different 
+// files lands in different buckets
+int
+PageTable::Hash(int file, int offset){
+	unsigned int h = (unsigned) offset * 2654435761u + (unsigned) file * 40503u;
+	return (h ^ (h >> 16)) & hashMask;
+}
+
+// the code cache is hashed on <file, offset>, one bucket per frame
+// (rounded up to a power of 2)
+int
+PageTable::FindCached(int file, int offset){
+	int frame;
+	for (frame = cacheBucket[Hash(file, offset)]; frame != -1; frame = cacheNext[frame]) {
+		if((cacheFile[frame] == file) && (cacheOffset[frame] == offset))
+			return frame;
+	}
+	return -1;
+}
+
+void
+PageTable::CacheInsert(int frame, int file, int offset){
+	int bucket = Hash(file, offset);
+	ASSERT(cacheFile[frame] == -1);
+	cacheFile[frame] = file;
+	cacheOffset[frame] = offset;
+	cacheNext[frame] = cacheBucket[bucket];
+	cacheBucket[bucket] = frame;
+}
+
+void
+PageTable::CacheRemove(int frame){
+	int *link = &cacheBucket[Hash(cacheFile[frame], cacheOffset[frame])];
+	while (*link != frame) {
+		ASSERT(*link != -1);
+		link = &cacheNext[*link];
+	}
+	*link = cacheNext[frame];
+	cacheNext[frame] = -1;
+	cacheFile[frame] = -1;
+}
+
+// map page "vpn" of thread "threadId" to "frame"; the mapping slots 
+// double when they run out
+int
+PageTable::AddMapping(int frame, int threadId, int vpn, bool readOnly){
+	TranslationEntry *entries;
+	int *next;
+	int i, m;
+
+	if (freeMap == -1) {
+		entries = new TranslationEntry[2 * mapSize];
+		next = new int[2 * mapSize];
+		for (i = 0; i < mapSize; i++) {
+			entries[i] = mapEntry[i];
+			next[i] = mapNext[i];
+		}
+		for (i = mapSize; i < 2 * mapSize; i++) {
+			entries[i].valid = FALSE;
+			next[i] = i + 1;
+		}
+		next[2 * mapSize - 1] = -1;
+		freeMap = mapSize;
+		delete [] mapEntry;
+		delete [] mapNext;
+		mapEntry = entries;
+		mapNext = next;
+		mapSize *= 2;
+	}
+	m = freeMap;
+	freeMap = mapNext[m];
+	mapEntry[m].threadId = threadId;
+	mapEntry[m].virtualPage = vpn;
+	mapEntry[m].physicalPage = frame;
+	mapEntry[m].readOnly = readOnly;
+	mapEntry[m].valid = TRUE;
+	mapEntry[m].use = FALSE;
+	mapEntry[m].dirty = FALSE;
+	mapEntry[m].large = FALSE;
+	mapNext[m] = frameMap[frame];
+	frameMap[frame] = m;
+	refCount[frame]++;
+	Directory(threadId)->Set(vpn, m);
+	SpaceOf(threadId)->resident++;
+	return m;
+}
+
+// unmap a page: take the mapping off its frame, out of its page table
+// and out of the TLB
+void
+PageTable::RemoveMapping(int m){
+	int frame = mapEntry[m].physicalPage;
+	int *link;
+
+	if (mapEntry[m].large)
+		Demote(m);
+	link = &frameMap[frame];
+	while (*link != m) {
+		ASSERT(*link != -1);
+		link = &mapNext[*link];
+	}
+	*link = mapNext[m];
+	refCount[frame]--;
+	Shootdown(mapEntry[m].threadId, mapEntry[m].virtualPage);
+	Directory(mapEntry[m].threadId)->Set(mapEntry[m].virtualPage, -1);
+	SpaceOf(mapEntry[m].threadId)->resident--;
+	mapEntry[m].valid = FALSE;
+	mapNext[m] = freeMap;
+	freeMap = m;
+}
+
+// drop the TLB entry of a page, under the id its address space has
+void
+PageTable::Shootdown(int threadId, int vpn){
+	AddrSpace *space = SpaceOf(threadId);
+	machine->InvalidateMemo();
+	if (machine->tlb != NULL)
+		machine->tlb->Invalidate(space->asid, space->asidGeneration, vpn);
+}
+
+// a copy-on-write frame down to one mapping can be written in place
+void
+PageTable::Unshare(int frame){
+	int m = frameMap[frame];
+	if (refCount[frame] != 1 || !copyOnWrite[frame])
+		return;
+	copyOnWrite[frame] = FALSE;
+	mapEntry[m].readOnly = FALSE;
+	Shootdown(mapEntry[m].threadId, mapEntry[m].virtualPage);	// stale
+}
+
+// pick the page to replace, as the policy says, from the frames in use
+int
+PageTable::Victim(){
+	int i, frame, pass, oldest, now;
+	TranslationEntry *entry;
+
+	switch (policy) {
+	  case PageLeastFrequent:
+		frame = -1;
+		for (i = 0; i < entrySize; i++) {
+			if (Eligible(i) && (frame == -1 || hitRecord[i] < hitRecord[frame]))
+				frame = i;
+		}
+		return frame;
+
+	  case PageClock:
+		for (;;) {
+			entry = &pgTableEntry[hand];
+			frame = hand;
+			hand = (hand + 1) % entrySize;
+			if (!Eligible(frame))
+				continue;
+			if (!entry->use)
+				return frame;
+			entry->use = FALSE;
+		}
+
+	  case PageSecondChance:
+		// first look for a page that is neither used nor dirty, 
+		// without touching anything; then for one that is not used,
+		// clearing use bits as we go.  After that second pass, every
+		// page is unused, so the loop ends on the next round.
+		for (pass = 0; ; pass = 1 - pass) {
+			for (i = 0; i < entrySize; i++) {
+				entry = &pgTableEntry[hand];
+				frame = hand;
+				hand = (hand + 1) % entrySize;
+				if (!Eligible(frame))
+					continue;
+				if (!entry->use && (pass == 1 || !entry->dirty))
+					return frame;
+				if (pass == 1)
+					entry->use = FALSE;
+			}
+		}
+
+	  case PageWSClock:
+		// one trip round the clock: pages used since the last trip
+		// are in the working set; take the first clean one that 
+		// isn't, else a dirty one, else the least recently used
+		now = stats->totalTicks;
+		frame = oldest = -1;
+		for (i = 0; i < entrySize; i++) {
+			entry = &pgTableEntry[hand];
+			if (entry->use) {
+				entry->use = FALSE;
+				lastUse[hand] = now;
+			} else if (!Eligible(hand))
+				;
+			else if (now - lastUse[hand] > WorkingSetWindow) {
+				if (!entry->dirty) {
+					frame = hand;
+					hand = (hand + 1) % entrySize;
+					return frame;
+				}
+				if (frame == -1)
+					frame = hand;
+			}
+			if (Eligible(hand) && (oldest == -1 || lastUse[hand] < lastUse[oldest]))
+				oldest = hand;
+			hand = (hand + 1) % entrySize;
+		}
+		return (frame != -1) ? frame : oldest;
+
+	  case PageAging:
+		frame = -1;
+		for (i = 0; i < entrySize; i++) {
+			if (Eligible(i) && (frame == -1 || history[i] < history[frame]))
+				frame = i;
+		}
+		return frame;
+	}
+	return 0;
+}
+
+// aging: once every AgingInterval ticks (see Interrupt::OneTick), 
+// shift each page's use bit in on top of its history byte, and clear
+// it, so the history says in which of the last intervals it was used
+void
+PageTable::Age(){
 	int i;
 	for (i = 0; i < entrySize; i++) {
-		if((pgTableEntry[i].threadId == threadId) && (pgTableEntry[i].virtualPage == vpn) && pgTableEntry[i].valid){
-			hitRecord[i]++;
-			break;
+		history[i] = (history[i] >> 1) | (pgTableEntry[i].use ? 0x80 : 0);
+		pgTableEntry[i].use = FALSE;
+	}
+	nextAging = stats->totalTicks + AgingInterval;
+}
+
+// save a modified page in the swap area of each thread mapping it, 
+// leaving it in its frame.  It is clean from the start, so that a 
+// store while it is being written makes it dirty again; a memoized 
+// store doesn't set the dirty bits, so the memos go.
+void
+PageTable::Clean(int frame){
+	char *memory = &(machine->mainMemory[frame * PageSize]);
+	Thread *owner;
+	int m;
+
+	pgTableEntry[frame].dirty = FALSE;
+	machine->InvalidateMemo();
+	for (m = frameMap[frame]; m != -1; m = mapNext[m]) {
+		owner = Thread::getThread(mapEntry[m].threadId);
+		ASSERT(owner != NULL && owner->space != NULL);
+		owner->space->SwapOut(mapEntry[m].virtualPage, memory);
+	}
+}
+
+// empty a frame: a modified page must be saved first; a clean one is 
+// in the swap area already, or can be re-read from the executable
+void
+PageTable::Evict(int frame){
+	stats->numPageEvictions++;
+	if (pgTableEntry[frame].dirty) {
+		stats->numDirtyEvictions++;
+		Clean(frame);
+	}
+	while (frameMap[frame] != -1)
+		RemoveMapping(frameMap[frame]);
+	Free(frame);
+}
+
+// the last mapping of a frame is gone
+void
+PageTable::Free(int frame){
+	ASSERT(refCount[frame] == 0);
+	if (cacheFile[frame] != -1)
+		CacheRemove(frame);
+	copyOnWrite[frame] = FALSE;
+	pgTableEntry[frame].valid = FALSE;
+	numFree++;
+	FrameChanged();
+}
+
+// a fault that finds no frame it can take waits for one
+void
+PageTable::WaitForFrame(){
+	frameWaiters++;
+	frameFreed->P();
+}
+
+// a frame was freed, or is no longer busy: let the waiting faults look
+// again
+void
+PageTable::FrameChanged(){
+	while (frameWaiters > 0) {
+		frameWaiters--;
+		frameFreed->V();
+	}
+}
+
+// with quotas, a thread at its quota must replace one of its own 
+// pages, and one under it a page of a program over its quota; if there
+// are none of those, any page will do
+void
+PageTable::Restrict(){
+	AddrSpace *space = currentThread->space;	// NULL for the daemon
+	bool local = (space != NULL && space->resident >= space->quota);
+	AddrSpace *owner;
+	int frame, m, count = 0;
+
+	restricted = frameQuotas;
+	if (!restricted)
+		return;
+	for (frame = 0; frame < entrySize; frame++) {
+		eligible[frame] = FALSE;
+		for (m = frameMap[frame]; m != -1 && !eligible[frame]; m = mapNext[m]) {
+			owner = SpaceOf(mapEntry[m].threadId);
+			if (local)
+				eligible[frame] = (owner == space);
+			else
+				eligible[frame] = (owner->resident > owner->quota);
 		}
+		if (eligible[frame] && !busy[frame])
+			count++;
 	}
-	if(i < entrySize){
-		return &pgTableEntry[i];
+	if (count == 0)
+		restricted = FALSE;
+}
+
+// a frame to put a new page in, evicting whatever is there.  It is 
+// busy, and no longer counted free, from now until Map, so that no 
+// other fault takes it while the page is read in.
+int
+PageTable::FreeFrame(int want){
+	int frame;
+
+	// with the daemon, wait for it to free a frame rather than write
+	// a page back here; without it, only if every frame is busy
+	while (numFree == 0 && (pageoutWanted != NULL || numBusy == entrySize)) {
+		stats->numFrameWaits++;
+		WakePageout();
+		WaitForFrame();
 	}
-	else{
-		return NULL;
+	if (want != -1 && !pgTableEntry[want].valid && !busy[want]) {
+		frame = want;
+		stats->numFreeFrameHits++;
+	} else if (numFree > 0) {
+		frame = -1;
+		if (superpageSize > 1) {	// keep empty groups for superpages
+			for (frame = 0; frame < entrySize; frame++) {
+				if (!pgTableEntry[frame].valid && !busy[frame]
+						&& GroupFree(frame - frame % superpageSize) < superpageSize)
+					break;
+			}
+			if (frame == entrySize)
+				frame = -1;
+		}
+		if (frame == -1)
+			for (frame = 0; pgTableEntry[frame].valid || busy[frame]; frame++)
+				;
+		stats->numFreeFrameHits++;
+	} else {
+		Restrict();
+		frame = Victim();
+		busy[frame] = TRUE;		// while it is written back
+		numBusy++;
+		Evict(frame);
 	}
+	if (!busy[frame]) {
+		busy[frame] = TRUE;
+		numBusy++;
+	}
+	numFree--;
+	if (numFree < lowWater)
+		WakePageout();
+	return frame;
 }
 
 void
-PageTable::Swap(int vpn){
-	int codeBegin = currentThread->space->noffH.code.virtualAddr;
-	int codeEnd = currentThread->space->noffH.code.virtualAddr + currentThread->space->noffH.code.size;
-	
-	int initDataBegin = currentThread->space->noffH.initData.virtualAddr;
-	int initDataEnd = currentThread->space->noffH.initData.virtualAddr + currentThread->space->noffH.initData.size;
-	
-	int uninitDataBegin = currentThread->space->noffH.uninitData.virtualAddr;
-	int uninitDataEnd = currentThread->space->noffH.uninitData.virtualAddr + currentThread->space->noffH.uninitData.size;
-	
-	int requestVA = vpn * PageSize;
-	int size1,i;
-	
-	OpenFile *executable = fileSystem->Open(currentThread->userFileName);
-	
-	int swapIndex = 0;
-	int minHit = hitRecord[0];
-	
-	stats->numPageFaults++;
-	
-	for(i = 0; i < entrySize; i++){
-		if(!pgTableEntry[i].valid) {
-			swapIndex = i;
-			break;
+PageTable::WakePageout(){
+	if (pageoutWaiting) {
+		pageoutWaiting = FALSE;
+		pageoutWanted->V();
+	}
+}
+
+static void
+PageoutDaemon(int arg)
+{
+	machine->pageTable->Pageout();
+}
+
+void
+PageTable::StartPageout(){
+	Thread *daemon = new Thread("pageout");
+	pageoutWanted = new Semaphore("pageout wanted", 0);
+	daemon->Fork(PageoutDaemon, 0);
+}
+
+// the pageout daemon: whenever the free frames drop below the low 
+// mark, free pages the replacement policy picks until they are back
+// at the high mark, a batch at a time.  The modified pages of a batch
+// are written back together, while all of it is busy; then those not
+// modified again meanwhile are freed, and are clean free frames for 
+// the faults.
+void
+PageTable::Pageout(){
+	int batch[PageoutBatch];
+	int frame, count, i;
+
+	for (;;) {
+		while (numFree >= lowWater) {
+			pageoutWaiting = TRUE;
+			pageoutWanted->P();
 		}
-		if(hitRecord[i] < minHit) {
-			minHit = hitRecord[i];
-			swapIndex = i;
+		stats->numPageoutRuns++;
+		while (numFree < highWater) {
+			for (count = 0; count < PageoutBatch && numFree + count < highWater
+					&& numBusy < entrySize - numFree; count++) {
+				Restrict();
+				frame = Victim();
+				busy[frame] = TRUE;
+				numBusy++;
+				batch[count] = frame;
+			}
+			for (i = 0; i < count; i++) {
+				if (pgTableEntry[batch[i]].dirty) {
+					Clean(batch[i]);
+					stats->numPagesCleaned++;
+				}
+			}
+			for (i = 0; i < count; i++) {
+				frame = batch[i];
+				busy[frame] = FALSE;
+				numBusy--;
+				if (refCount[frame] == 0)	// its program exited
+					Free(frame);
+				else if (!pgTableEntry[frame].dirty) {
+					Evict(frame);		// nothing to write
+					stats->numPagesReclaimed++;
+				} else
+					FrameChanged();		// it can be picked again
+			}
+			currentThread->Yield();		// let the faulting threads on
 		}
 	}
-	
-	//invalidate the tlb entry
-	for(i = 0; i < machine->tlb->bufferSize; i++){
-		if(machine->tlb->tlbTable[i].threadId == pgTableEntry[swapIndex].threadId && machine->tlb->tlbTable[i].virtualPage == pgTableEntry[swapIndex].virtualPage){
-			machine->tlb->tlbTable[i].valid = FALSE;
+}
+
+// give back the frames of a thread whose program has exited; this may
+// leave room for a suspended one
+void
+PageTable::Release(int threadId){
+	Unmap(threadId, FALSE);
+	if (loadControl)
+		Resume(threadId);
+}
+
+// take all its pages away from a thread; those it shares stay, with 
+// one mapping fewer.  Pages it modified are saved in its swap area if
+// it is to run again.
+void
+PageTable::Unmap(int threadId, bool save){
+	AddrSpace *space = SpaceOf(threadId);
+	int frame, m, next;
+	for (frame = 0; frame < entrySize; frame++) {
+		if (!pgTableEntry[frame].valid)
+			continue;
+		for (m = frameMap[frame]; m != -1; m = next) {
+			next = mapNext[m];
+			if (mapEntry[m].threadId != threadId)
+				continue;
+			if (save && pgTableEntry[frame].dirty)
+				space->SwapOut(mapEntry[m].virtualPage, 
+					&(machine->mainMemory[frame * PageSize]));
+			RemoveMapping(m);
 		}
+		if (refCount[frame] == 0) {
+			if (!busy[frame])	// else it is freed once written
+				Free(frame);
+		} else
+			Unshare(frame);
 	}
+}
 
-	pgTableEntry[swapIndex].readOnly = FALSE;
-	pgTableEntry[swapIndex].threadId = currentThread->threadId;
-	pgTableEntry[swapIndex].virtualPage = vpn;
-	pgTableEntry[swapIndex].valid = TRUE;
-	hitRecord[swapIndex] = 1;
-	
-	if (requestVA >= codeBegin && requestVA < codeEnd){
-		// if the request page cross a segment
-		if (requestVA + PageSize > codeEnd){
-			size1 = codeEnd - requestVA;
-			executable->ReadAt(&(machine->mainMemory[swapIndex * PageSize]),
-			size1, currentThread->space->noffH.code.inFileAddr + requestVA - codeBegin);
-			if(currentThread->space->noffH.uninitData.size != 0){
-				executable->ReadAt(&(machine->mainMemory[swapIndex * PageSize+size1]),
-				PageSize - size1, currentThread->space->noffH.uninitData.inFileAddr);				
-			}
+// page-fault frequency: a program faulting often needs more frames, 
+// one faulting rarely can do with fewer
+void
+PageTable::AdjustQuota(AddrSpace *space){
+	int interval = stats->totalTicks - space->lastFault;
+
+	space->lastFault = stats->totalTicks;
+	if (interval < PFFLow && space->quota < entrySize) {
+		space->quota++;
+		stats->numQuotaGrows++;
+	} else if (interval > PFFHigh && space->quota > MinQuota) {
+		space->quota--;
+		stats->numQuotaShrinks++;
+		if (loadControl)
+			Resume(-1);
+	}
+}
+
+// add up the quotas of the programs that are not suspended, leaving 
+// out thread "exclude"; "*active" is set to how many there are
+int
+PageTable::Demand(int exclude, int *active){
+	Thread *thread;
+	int i, demand = 0;
+
+	*active = 0;
+	for (i = 0; i < MAX_ALLOWED_THREAD; i++) {
+		thread = Thread::getThread(i);
+		if (i == exclude || thread == NULL || thread->space == NULL 
+				|| thread->space->suspended)
+			continue;
+		demand += thread->space->quota;
+		(*active)++;
+	}
+	return demand;
+}
+
+// the quotas don't fit in memory: put the current thread to sleep, its
+// pages written out, until they do
+void
+PageTable::Suspend(){
+	AddrSpace *space = currentThread->space;
+	IntStatus oldLevel;
+
+	DEBUG('a', "Suspending thread %d, quota %d\n", currentThread->threadId,
+		space->quota);
+	stats->numSuspensions++;
+	Unmap(currentThread->threadId, TRUE);
+	space->suspended = TRUE;
+	oldLevel = interrupt->SetLevel(IntOff);
+	suspended->Append((void *) currentThread);
+	currentThread->Sleep();
+	(void) interrupt->SetLevel(oldLevel);
+}
+
+// let suspended threads run again, first come first served, while 
+// their quotas fit (or if nothing else is left to run)
+void
+PageTable::Resume(int exclude){
+	Thread *thread;
+	IntStatus oldLevel;
+	int active, demand;
+
+	while (!suspended->IsEmpty()) {
+		thread = (Thread *) suspended->Remove();
+		demand = Demand(exclude, &active);
+		if (active > 0 && demand + thread->space->quota > entrySize) {
+			suspended->Prepend((void *) thread);
+			break;
 		}
-		else{	//else just read the code page
-			executable->ReadAt(&(machine->mainMemory[swapIndex * PageSize]),PageSize, currentThread->space->noffH.code.inFileAddr + requestVA - codeBegin);
-			pgTableEntry[swapIndex].readOnly = TRUE;
+		DEBUG('a', "Resuming thread %d\n", thread->threadId);
+		thread->space->suspended = FALSE;
+		oldLevel = interrupt->SetLevel(IntOff);
+		scheduler->ReadyToRun(thread);
+		(void) interrupt->SetLevel(oldLevel);
+	}
+}
+
+// the frame must be one FreeFrame handed out, its page read in; 
+// "used" is FALSE for a page that was only prefetched, so that 
+// replacement doesn't count it as referenced
+int
+PageTable::Map(int frame, int vpn, bool used, bool readOnly){
+	int m;
+
+	ASSERT(!pgTableEntry[frame].valid && busy[frame]);
+	machine->InvalidateFrame(frame);	// it is getting new contents
+	pgTableEntry[frame].valid = TRUE;
+	pgTableEntry[frame].use = used;
+	pgTableEntry[frame].dirty = FALSE;
+	hitRecord[frame] = used ? 1 : 0;
+	lastUse[frame] = stats->totalTicks;
+	history[frame] = used ? 0x80 : 0;
+	busy[frame] = FALSE;
+	numBusy--;
+	m = AddMapping(frame, currentThread->threadId, vpn, readOnly);
+	FrameChanged();
+	return m;
+}
+
+// read the pages after "vpn" that the address space says are likely 
+// to be wanted soon, in one go, into frames that are free anyway
+void
+PageTable::FaultAround(int vpn){
+	AddrSpace *space = currentThread->space;
+	int count, frame, offset, i;
+	int *frames;
+	char **into;
+	bool readOnly;
+
+	count = min(space->FaultAround(vpn, faultAround), numFree);
+	if (frameQuotas)			// nor beyond the quota
+		count = min(count, space->quota - space->resident);
+	if (pageoutWanted != NULL)		// nor the daemon's reserve
+		count = min(count, numFree - lowWater);
+	for (i = 0; i < count; i++) {		// stop at one already here
+		if (FindMapping(currentThread->threadId, vpn + 1 + i) != -1)
+			break;
+		offset = space->CodeOffset(vpn + 1 + i);
+		if (offset != -1 && FindCached(space->ProgramId(), offset) != -1)
+			break;
+	}
+	count = i;
+	if (count == 0)
+		return;
+
+	frames = new int[count];
+	into = new char *[count];
+	for (i = 0, frame = 0; i < count; frame++) {
+		if (!pgTableEntry[frame].valid && !busy[frame]) {
+			busy[frame] = TRUE;	// as FreeFrame leaves it
+			numBusy++;
+			numFree--;
+			frames[i] = frame;
+			into[i++] = &(machine->mainMemory[frame * PageSize]);
 		}
 	}
-	else if(requestVA >= uninitDataBegin && requestVA < uninitDataEnd){
-		executable->ReadAt(&(machine->mainMemory[swapIndex * PageSize]),
-			PageSize, currentThread->space->noffH.uninitData.inFileAddr + requestVA - uninitDataBegin);		
+	readOnly = space->LoadPages(vpn + 1, count, into);
+	for (i = 0; i < count; i++) {
+		Map(frames[i], vpn + 1 + i, FALSE, readOnly);
+		if (readOnly)
+			CacheInsert(frames[i], space->ProgramId(), 
+					space->CodeOffset(vpn + 1 + i));
 	}
-	else if(requestVA >= initDataBegin && requestVA < initDataEnd){
-		executable->ReadAt(&(machine->mainMemory[swapIndex * PageSize]),
-			PageSize, currentThread->space->noffH.initData.inFileAddr + requestVA - initDataBegin);		
+	for (i = 0; i < count && superpageSize > 1; i++)
+		Promote(vpn + 1 + i);
+	stats->numPagesPrefetched += count;
+	delete [] frames;
+	delete [] into;
+}
+
+void
+PageTable::Swap(int vpn){
+	int active;
+
+	if (!currentThread->space->Contains(vpn)) {	// a wild pointer
+		printf("Bad address 0x%x\n", machine->ReadRegister(BadVAddrReg));
+		ASSERT(FALSE);
 	}
-	delete executable;
+	stats->numPageFaults++;
+	CountEvent(PageFaultCounter, 1);
+	if (frameQuotas)
+		AdjustQuota(currentThread->space);
+	if (loadControl && Demand(-1, &active) > entrySize && active > 1)
+		Suspend();
+	Bring(vpn, TRUE);
+	if (faultAround > 0)
+		FaultAround(vpn);
 }
 
+// load a page of the current thread before it is used (when the 
+// program starts, say), unless it is already there; not a fault
+void
+PageTable::Preload(int vpn){
+	if (FindMapping(currentThread->threadId, vpn) == -1)
+		Bring(vpn, FALSE);
+}
 
+// make room for page "vpn" of the current thread, and read it in; 
+// unless it is code that another address space running the program
+// already has in memory, which is just mapped
+void
+PageTable::Bring(int vpn, bool used){
+	AddrSpace *space = currentThread->space;
+	int offset = space->CodeOffset(vpn);
+	int frame = -1;
+	char *memory;
+	bool readOnly = FALSE;
 
+	if (offset != -1)
+		frame = FindCached(space->ProgramId(), offset);
+	if (frame != -1) {
+		stats->numCodePagesShared++;
+		AddMapping(frame, currentThread->threadId, vpn, TRUE);
+		if (used) {
+			pgTableEntry[frame].use = TRUE;
+			hitRecord[frame]++;
+			lastUse[frame] = stats->totalTicks;
+		}
+		return;
+	}
 
+	frame = FreeFrame((superpageSize > 1) ? GroupFrame(vpn) : -1);
+	memory = &(machine->mainMemory[frame * PageSize]);
+	// if it was modified, only the swap area has it as it is now
+	if (!space->SwapIn(vpn, memory))
+		readOnly = space->LoadPage(vpn, memory);
+	Map(frame, vpn, used, readOnly);
+	if (offset != -1)
+		CacheInsert(frame, space->ProgramId(), offset);
+	if (superpageSize > 1)
+		Promote(vpn);
+}
 
+// how many frames of the aligned group starting at "first" are free
+int
+PageTable::GroupFree(int first){
+	int i, count = 0;
+	for (i = first; i < first + superpageSize; i++) {
+		if (!pgTableEntry[i].valid && !busy[i])
+			count++;
+	}
+	return count;
+}
 
+// the frame to bring page "vpn" of the current thread into, so that 
+// its group can become a superpage: its place in the group of frames 
+// where the group's other pages are, or in an empty group; -1 if 
+// there is none
+int
+PageTable::GroupFrame(int vpn){
+	int group = vpn - vpn % superpageSize;
+	int i, m, first;
 
+	for (i = 0; i < superpageSize; i++) {
+		m = FindMapping(currentThread->threadId, group + i);
+		if (m != -1) {
+			first = mapEntry[m].physicalPage - i;
+			if (first < 0 || first % superpageSize != 0)
+				return -1;	// not placed for a superpage
+			return first + vpn % superpageSize;
+		}
+	}
+	for (first = 0; first < entrySize; first += superpageSize) {
+		if (GroupFree(first) == superpageSize)
+			return first + vpn % superpageSize;
+	}
+	return -1;
+}
 
+// if all the pages in the group of "vpn" are in memory, in order in an
+// aligned group of frames, with the same protection, and none shared
+// copy-on-write, map them as a superpage
+void
+PageTable::Promote(int vpn){
+	int group = vpn - vpn % superpageSize;
+	int i, m, first = -1;
+	bool readOnly = FALSE;
 
+	for (i = 0; i < superpageSize; i++) {
+		m = FindMapping(currentThread->threadId, group + i);
+		if (m == -1 || mapEntry[m].large || copyOnWrite[mapEntry[m].physicalPage])
+			return;
+		if (i == 0) {
+			first = mapEntry[m].physicalPage;
+			readOnly = mapEntry[m].readOnly;
+			if (first % superpageSize != 0)
+				return;
+		} else if (mapEntry[m].physicalPage != first + i 
+				|| mapEntry[m].readOnly != readOnly)
+			return;
+	}
+	for (i = 0; i < superpageSize; i++) {
+		m = FindMapping(currentThread->threadId, group + i);
+		mapEntry[m].large = TRUE;
+		Shootdown(currentThread->threadId, group + i);	// the small entries
+	}
+	stats->numPromotions++;
+	DEBUG('a', "Promoted pages %d..%d to a superpage\n", group, 
+		group + superpageSize - 1);
+}
 
+// mapping "m" is changing: split its superpage back into pages
+void
+PageTable::Demote(int m){
+	int threadId = mapEntry[m].threadId;
+	int vpn = mapEntry[m].virtualPage;
+	int group = vpn - vpn % superpageSize;
+	int i, other;
 
+	for (i = 0; i < superpageSize; i++) {
+		other = FindMapping(threadId, group + i);
+		if (other != -1)
+			mapEntry[other].large = FALSE;
+	}
+	Shootdown(threadId, vpn);		// the superpage entry
+	stats->numDemotions++;
+}
 
+// give thread "toId" the pages of thread "fromId" that are in memory,
+// by mapping their frames, not copying them.  Pages that could be 
+// written become read-only in both, until one of them writes (see 
+// CopyOnWrite).
+void
+PageTable::Share(int fromId, int toId){
+	int frame, m, next;
+	for (frame = 0; frame < entrySize; frame++) {
+		if (!pgTableEntry[frame].valid)
+			continue;
+		for (m = frameMap[frame]; m != -1; m = next) {
+			next = mapNext[m];
+			if (mapEntry[m].threadId != fromId)
+				continue;
+			if (mapEntry[m].large)
+				Demote(m);
+			if (!mapEntry[m].readOnly) {
+				copyOnWrite[frame] = TRUE;
+				mapEntry[m].readOnly = TRUE;
+				Shootdown(fromId, mapEntry[m].virtualPage);
+			}
+			AddMapping(frame, toId, mapEntry[m].virtualPage, TRUE);
+			stats->numPagesShared++;
+		}
+	}
+}
 
+// the current thread wrote to page "vpn", which is mapped read-only:
+// if that is only because it is shared copy-on-write, give the thread
+// a copy of its own (or, if nobody else has it any more, the page 
+// itself) to write.  Returns FALSE if the page really is read-only.
+bool
+PageTable::CopyOnWrite(int vpn){
+	int m = FindMapping(currentThread->threadId, vpn);
+	int frame, copy;
+	char *buffer;
+	bool dirty;
 
+	if (m == -1)			// gone since; it will fault back in
+		return TRUE;
+	frame = mapEntry[m].physicalPage;
+	if (!mapEntry[m].readOnly) {	// the TLB had an old read-only copy
+		Shootdown(currentThread->threadId, vpn);
+		return TRUE;
+	}
+	if (!copyOnWrite[frame])
+		return FALSE;
+	stats->numCopyOnWrites++;
+	if (refCount[frame] == 1) {
+		Unshare(frame);
+		return TRUE;
+	}
 
+	// save the contents first: making room may evict this very frame
+	buffer = new char[PageSize];
+	bcopy(&(machine->mainMemory[frame * PageSize]), buffer, PageSize);
+	dirty = pgTableEntry[frame].dirty;
+	RemoveMapping(m);
+	Unshare(frame);
+	copy = FreeFrame(-1);
+	Map(copy, vpn, TRUE, FALSE);
+	bcopy(buffer, &(machine->mainMemory[copy * PageSize]), PageSize);
+	pgTableEntry[copy].dirty = dirty;	// as far as its swap area knows
+	delete [] buffer;
+	return TRUE;
+}
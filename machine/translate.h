@@ -41,30 +41,283 @@ class TranslationEntry {
 			// page is referenced or modified.
     bool dirty;         // This bit is set by the hardware every time the
 			// page is modified.
+    int asid;		// In the TLB: the address space the entry is for
+    bool large;		// If this bit is set, the page is part of a 
+			// superpage: in the TLB, the entry maps the 
+			// "superpageSize" pages from "virtualPage" on
+			// to the frames from "physicalPage" on.
 };
 
 // tlb implemented by zz
+//
+// The TLB is split into sets of "ways" entries each; a virtual page can
+// only be cached in set (vpn % number of sets), so a lookup only checks
+// that set.  One set of "bufferSize" ways is fully associative, sets of 
+// one way are direct mapped.  The replacement policy picks the victim 
+// within the set.
+//
+// With superpages (-superpage), an entry can also map an aligned group
+// of pages to an aligned group of frames.  Such an entry goes in the 
+// set of its group, (vpn / superpageSize) % number of sets, so a lookup
+// checks that set too.
+//
+// Entries are tagged with an address space id (ASID), and only match 
+// while that address space is the current one, so the TLB keeps its
+// contents across context switches.  There are NumASIDs of them, handed
+// out in generations: when they run out, the whole TLB is flushed and 
+// a new generation starts, in which every address space gets a new id 
+// the next time it runs (see Activate).
+
+enum TLBPolicy { TLBLeastFrequent, TLBLeastRecent, TLBPseudoLRU, 
+		 TLBRandom, TLBClock };
+
+#define NumASIDs	64		// address space ids in the TLB tags
 
 class TLBuffer {
   public:
-	TranslationEntry *tlbTable;
-	int *hitRecord;
+	TranslationEntry *tlbTable;	// set s is entries s*ways .. s*ways+ways-1
+	int *hitRecord;			// for the policy: hit count (LFU), time
+					// of last use (LRU), reference bit (clock)
 	int bufferSize;
+	int ways;			// entries per set
+	int numSets;
+	TLBPolicy policy;
+	TranslationEntry *Lookup(int vpn);
+					// find a valid entry of the current
+					// address space, and tell the policy 
+					// it was used; NULL if none
+	void Invalidate(int asid, int generation, int vpn);
+					// drop one entry, if it is there
+	void Activate(int *asid, int *generation);
+					// switch to an address space, giving
+					// it an id if its own is stale
 	void Swap();
-	TLBuffer(int bfSize);		// initialize a Thread 
+	void Touch(int index);		// entry "index" was just used
+	TLBuffer(int bfSize, int assoc, TLBPolicy repl);
+					// "assoc" ways per set
     ~TLBuffer();
+
+  private:
+	int currentASID;		// the running address space's id
+	int generation;			// bumped each time the ids run out
+	int nextASID;			// the next id to hand out
+	void Flush();			// invalidate every entry
+	int LargeSet(int vpn);		// the first entry of the set where a
+					// superpage holding "vpn" would be
+	int useClock;			// LRU: time of the last use
+	unsigned int *plruBits;		// pseudo-LRU: per set, a tree of ways-1
+					// bits, each pointing to the half of 
+					// its subtree used less recently
+	int *clockHand;			// clock: per set, the next way to check
+	int Victim(int set);		// the entry of "set" to replace
+};
+
+// A two-level page table, one per address space: virtual page number
+// -> the index of its mapping in the PageTable, -1 if the page isn't in
+// memory.  The top bits of the page number pick a second-level table, 
+// which is only allocated once a page in its range is mapped, so a 
+// sparse address space (a program at the bottom, its stack at the top
+// of 2 GB, say) costs a couple of tables, and a lookup two loads.
+//
+// The directories are the index PageTable::getPage finds a page's 
+// mapping through, on every access without a TLB and on every TLB 
+// refill; it takes the same two loads however many frames or threads
+// there are.  Every address space has one, in every build that runs 
+// user programs, so no global index of the mappings is kept.
+
+#define PageTableBits	12		// pages per second-level table: 
+#define PageTableSize	(1 << PageTableBits)	// 2^12
+
+class PageDirectory {
+  public:
+	PageDirectory(int maxPages);	// for pages 0 .. maxPages-1
+	~PageDirectory();
+
+	int Find(int vpn);		// the mapping of a page, -1 if none
+	void Set(int vpn, int m);	// map it, or unmap it if "m" is -1
+
+  private:
+	int **tables;			// second-level tables, NULL if empty
+	int numTables;
 };
 
+// How PageTable::Swap picks the frame to replace, once memory is full.
+// All but the first go by the use and dirty bits Machine::Translate 
+// sets in the page table (through the TLB, if there is one).
+//
+//	least frequent -- fewest references since the page came in
+//	clock -- the next page round the clock not used since the hand 
+//		last passed (which clears the use bits as it goes)
+//	second chance -- clock, preferring pages that are clean as well
+//		as unused, so as not to throw away modified pages
+//	WSClock -- clock, taking the first clean page that has not been 
+//		used for more than WorkingSetWindow ticks (that is, has 
+//		dropped out of the working set)
+//	aging -- the smallest history byte; every AgingInterval ticks 
+//		every page's byte is shifted right, with its use bit 
+//		shifted in on top
+
+enum PagePolicy { PageLeastFrequent, PageClock, PageSecondChance, 
+		  PageWSClock, PageAging };
+
+#define WorkingSetWindow	1000	// WSClock: in ticks
+#define AgingInterval		100	// aging: ticks between shifts
+
+// With frame quotas (-pff), each program has a share of the frames, set
+// by its page-fault frequency: faulting again within PFFLow ticks of 
+// its last fault earns it another frame, going PFFHigh ticks without a
+// fault costs it one, down to MinQuota.  A program at its quota 
+// replaces one of its own pages; one under it takes a page from a 
+// program over its quota, if there is one.  With load control too 
+// (-loadctl), a program is suspended, all its pages written out, while
+// the quotas add up to more than memory.
+
+#define PFFLow		200
+#define PFFHigh		2000
+#define MinQuota	2
+#define InitialQuota	4
+
+// With the pageout daemon (-pageout), a kernel thread keeps between
+// the low and the high watermark of frames free -- an eighth and a 
+// quarter of memory -- so that a fault never has to wait for a page 
+// to be written out first: it takes a free frame, or, if there are 
+// none left, waits for the daemon to free some.  Woken when the free 
+// frames drop below the low mark, the daemon picks PageoutBatch pages
+// at a time, writes back the modified ones together, and frees those 
+// not modified again meanwhile, letting other threads run in between.
+//
+// A frame a page is being read into, or written out of, is busy: 
+// neither a fault nor the daemon picks it until that is done.
+
+#define PageoutBatch	4
+
+// With superpages (-superpage <n>), a page is brought, if it can be, 
+// into the frame at the same place in an aligned group of n frames as
+// the page is in its aligned group of n pages: the group already used 
+// for other pages of that group, or an empty one.  Once all n are in 
+// memory that way, with the same protection, they are promoted to a 
+// superpage, which the TLB maps with a single entry; when one of them 
+// leaves memory, or is shared copy-on-write, they are demoted again.
+
+class AddrSpace;
+class List;
+class Semaphore;
+
 class PageTable {
   public:
-	TranslationEntry *pgTableEntry;
+	TranslationEntry *pgTableEntry;	// per frame: in use or not, and
+					// its use and dirty bits
 	int *hitRecord;
 	int entrySize;
+	PagePolicy policy;
 	TranslationEntry *getPage(int threadId, int vpn);
 	void Swap(int vpn);
+	void Preload(int vpn);		// load a page that hasn't faulted yet
+	void Release(int threadId);	// free the frames of an exited thread,
+					// and resume programs that now fit
+	void Share(int fromId, int toId);
+					// map one thread's pages for another,
+					// copy-on-write
+	bool CopyOnWrite(int vpn);	// a write hit a read-only page; FALSE
+					// if it isn't copy-on-write
+	int numFree;			// frames not holding any page
+	void StartPageout();		// fork the pageout daemon
+	void Pageout();			// and what it does
+	void Age();			// aging: shift the use bits into the
+	int nextAging;			// history, when the time comes
 	
-	PageTable(int bfSize);		// initialize a Thread 
+	PageTable(int bfSize, PagePolicy repl);	// initialize a Thread 
     ~PageTable();
+
+  private:
+	int hand;			// the clock hand, for all the clocks
+	int *lastUse;			// WSClock: when the page was last seen 
+					// used
+	int *history;			// aging: the history byte
+	int Victim();			// pick the page to replace
+	bool *eligible;			// with quotas, the frames Victim may
+	bool restricted;		// pick, if restricted
+	void Restrict();		// decide which those are
+	bool Eligible(int frame) { return pgTableEntry[frame].valid 
+				&& !busy[frame]
+				&& (!restricted || eligible[frame]); }
+	void AdjustQuota(AddrSpace *space);
+					// page-fault frequency: after a fault
+	int Demand(int exclude, int *active);
+					// the quotas of programs not suspended
+	List *suspended;		// threads waiting for their quota to fit
+	void Suspend();			// suspend the current thread
+	void Resume(int exclude);	// resume those that fit now
+	void Unmap(int threadId, bool save);
+					// take away all of a thread's pages,
+					// saving those modified if "save"
+	AddrSpace *SpaceOf(int threadId);	// a thread's address space
+
+	int GroupFrame(int vpn);	// superpages: the frame for "vpn"
+	int GroupFree(int first);	// free frames in a group
+	void Promote(int vpn);		// make its group a superpage, if it
+					// can be
+	void Demote(int m);		// a page of a superpage is leaving it
+
+	int lowWater, highWater;	// pageout: the free frames to keep
+	Semaphore *pageoutWanted;	// wakes up the daemon
+	bool pageoutWaiting;		// TRUE while it waits to be woken
+	void WakePageout();		// wake it, if it is waiting
+	bool *busy;			// per frame, TRUE while a page is 
+	int numBusy;			// read into it or written out of it
+	Semaphore *frameFreed;		// faults waiting for a frame
+	int frameWaiters;		// how many
+	void WaitForFrame();		// wait for a frame to be freed, or to
+	void FrameChanged();		// stop being busy; and say one has
+	void Clean(int frame);		// save a modified page, keeping it
+	void Evict(int frame);		// empty a frame, saving its page
+	int FreeFrame(int want);	// a free frame ("want", if it is 
+					// free), or Victim, emptied; it is
+					// busy until Map
+	void Bring(int vpn, bool used);	// load a page of the current thread
+	int Map(int frame, int vpn, bool used, bool readOnly);
+					// put the current thread's page "vpn" 
+					// in a free frame
+	void FaultAround(int vpn);	// load the pages the current thread
+					// is expected to want after "vpn"
+
+	// the mappings <threadId, virtualPage> -> frame; each thread's 
+	// address space indexes its own in a PageDirectory
+	TranslationEntry *mapEntry;	// valid if the slot is in use
+	int *mapNext;			// next mapping of the same frame, or 
+					// next free slot; -1 at the end
+	int mapSize;			// slots in mapEntry (it grows)
+	int freeMap;			// first free slot, -1 if none
+	int *frameMap;			// per frame, its first mapping
+	int *refCount;			// per frame, how many mappings it has
+	bool *copyOnWrite;		// per frame, TRUE if its mappings are
+					// read-only only until written
+	PageDirectory *Directory(int threadId);
+					// the page table a thread uses
+	int FindMapping(int threadId, int vpn);
+					// the mapping of a page, -1 if none
+	int AddMapping(int frame, int threadId, int vpn, bool readOnly);
+	void RemoveMapping(int m);
+	void Shootdown(int threadId, int vpn);
+					// drop a page's TLB entry, if any
+	void Unshare(int frame);	// make a copy-on-write frame with one
+					// mapping left writable
+	void Free(int frame);		// a frame with no mappings left
+
+	// the code cache: frames holding a page of pure code, found by the
+	// executable and the offset in it, so that every address space 
+	// running the same program maps the same frame
+	int *cacheFile;			// per frame, the identity of the 
+					// executable, -1 if not in the cache
+	int *cacheOffset;		// and where the page is in it
+	int *cacheBucket;		// first frame in each bucket, -1 if none
+	int *cacheNext;			// next frame in the same bucket
+	int FindCached(int file, int offset);
+					// the frame with a code page, -1 if none
+	void CacheInsert(int frame, int file, int offset);
+	void CacheRemove(int frame);
+	int hashMask;			// number of buckets - 1 (a power of 2)
+	int Hash(int file, int offset);
 };
 
 
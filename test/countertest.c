@@ -0,0 +1,46 @@
+/* countertest.c
+ *	Test program for the performance counters (the Counter syscall).
+ *
+ *	Walks an array, storing into it and then loading from it, and 
+ *	checks that its own counters -- and those of its address space --
+ *	saw at least that many loads, stores, branches and instructions.
+ *	Exits with the number of checks that failed (0 if none); run with
+ *	"nachos -d a -x ../test/countertest" to see the status.  All the
+ *	counters are also printed when Nachos halts.
+ */
+
+#include "syscall.h"
+
+#define N	100
+
+int A[N];
+
+int
+main()
+{
+    int i, sum, failed;
+
+    for (i = 0; i < N; i++)
+	A[i] = i;
+    for (i = 0, sum = 0; i < N; i++)
+	sum += A[i];
+
+    failed = 0;
+    if (Counter(CounterStores, CounterThread) < N)
+	failed++;
+    if (Counter(CounterLoads, CounterThread) < N)
+	failed++;
+    if (Counter(CounterBranches, CounterThread) < 2 * N)
+	failed++;
+    if (Counter(CounterInstructions, CounterThread) < 4 * N)
+	failed++;
+    if (Counter(CounterSyscalls, CounterThread) < 4)	/* these calls */
+	failed++;
+    if (Counter(CounterLoads, CounterSpace) < N)
+	failed++;
+    if (Counter(-1, CounterThread) != -1)		/* no such counter */
+	failed++;
+    if (sum != N * (N - 1) / 2)
+	failed++;
+    Exit(failed);
+}
@@ -0,0 +1,41 @@
+/* forktest.c
+ *	Test program for Fork and copy-on-write.
+ *
+ *	The parent forks a child, which writes a global the two share: the
+ *	child must get a copy of its own, and the parent must still see 
+ *	the old value.  The parent then spins (so the child runs, and 
+ *	exits) and writes the global itself: by then it is the last 
+ *	holder of the page, which it gets back writable without a copy.
+ *
+ *	Each thread exits with status 0 if it saw what it should have,
+ *	1 if not.  Run with "nachos -d a -x ../test/forktest" to see the
+ *	exit statuses; the copy-on-write faults are in the "Fork:" line
+ *	of the statistics.
+ */
+
+#include "syscall.h"
+
+int shared = 1;		/* initialized data, shared copy-on-write by Fork */
+int spin;
+
+void
+child()
+{
+    shared = 2;				/* gets a copy of the page */
+    Exit(shared == 2 ? 0 : 1);
+}
+
+int
+main()
+{
+    int i;
+
+    Fork(child);
+    for (i = 0; i < 10000; i++)		/* time slices pass; the child */
+	;				/* runs, and exits */
+    if (shared != 1)			/* its write was to its own copy */
+	Exit(1);
+    shared = 3;				/* ours alone now */
+    spin = shared;
+    Exit(spin == 3 ? 0 : 1);
+}
@@ -130,6 +130,14 @@ Yield:
 	j	$31
 	.end Yield
 
+	.globl Counter
+	.ent	Counter
+Counter:
+	addiu $2,$0,SC_Counter
+	syscall
+	j	$31
+	.end Counter
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
@@ -8,8 +8,11 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+// Usage: nachos -d <debugflags> -rs <random seed #> -q <test #>
+//		-s -ca -x <nachos file> -c <consoleIn> <consoleOut>
+//		-tlb <entries> -assoc <ways> -tlbrepl <policy>
+//		-pagerepl <policy> -fa <pages> -load <mode> -pff -loadctl
+//		-pageout -superpage <pages> -mem <pages> -pagesize <bytes>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
@@ -20,8 +23,41 @@
 //    -rs causes Yield to occur at random (but repeatable) spots
 //    -z prints the copyright message
 //
+//  THREADS
+//    -q runs one of the tests in threadtest.cc; -q 5 times the queue
+//	of pending interrupts
+//
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -ca runs user programs one instruction and one tick at a time,
+//	instead of a basic block at a time with ticks charged in bulk
+//    -tlb sets the number of TLB entries (if there is a TLB)
+//    -assoc sets how many TLB entries a page can go in: 1 is direct 
+//	mapped, the number of entries (the default) fully associative
+//    -tlbrepl picks the TLB replacement policy within a set: lfu (the
+//	default), lru, plru (tree pseudo-LRU), random or clock
+//    -pagerepl picks the page replacement policy (cf. translate.h): lfu
+//	(the default), clock, esc (enhanced second chance), wsclock or aging
+//    -fa loads up to that many pages of a program after the one that 
+//	faulted, if they are free, starting small and growing while the
+//	faults are sequential (0, the default, turns this off)
+//    -load sets how much of a program -x loads before starting it: lazy
+//	(the default) loads nothing, eager everything that fits, hybrid
+//	the first code page and the top of the stack
+//    -pff gives each program a quota of frames, grown when it faults 
+//	often and shrunk when it rarely does (page-fault frequency); a 
+//	program at its quota replaces one of its own pages
+//    -loadctl also suspends a program when the quotas add up to more 
+//	than physical memory, until they fit again (implies -pff)
+//    -pageout starts a kernel thread that frees pages in the background
+//	whenever free frames run low, so faults seldom wait for a page to
+//	be written out
+//    -superpage maps aligned groups of that many pages, once they are
+//	all in memory in an aligned group of frames, with one TLB entry
+//	(1, the default, turns this off)
+//    -mem sets the number of pages of physical memory (32 by default)
+//    -pagesize sets the size of a page in bytes, a multiple of 4 (by 
+//	default the disk sector size, 128)
 //    -x runs a user program
 //    -c tests the console
 //
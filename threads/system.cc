@@ -29,6 +29,12 @@ SynchDisk   *synchDisk;
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+int faultAround = 0;	// most pages to load along with a faulting one
+LoadMode loadMode = LoadLazy;	// how much of a program to load up front
+bool frameQuotas = FALSE;	// give each program its own share of frames
+bool loadControl = FALSE;	// suspend programs when the shares don't fit
+bool pageoutDaemon = FALSE;	// keep frames free in the background
+int superpageSize = 1;		// pages in a superpage, 1 for none
 #endif
 
 #ifdef NETWORK
@@ -83,6 +89,11 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool cycleAccurate = FALSE;	// no basic blocks, no batched ticks
+    int tlbSize = TLBSize;	// TLB entries
+    int tlbWays = 0;		// ways per TLB set, 0 for fully associative
+    TLBPolicy tlbPolicy = TLBLeastFrequent;	// TLB replacement policy
+    PagePolicy pagePolicy = PageLeastFrequent;	// page replacement policy
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -111,6 +122,80 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-ca"))
+	    cycleAccurate = TRUE;
+	else if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    tlbSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-assoc")) {
+	    ASSERT(argc > 1);
+	    tlbWays = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlbrepl")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "lfu"))
+		tlbPolicy = TLBLeastFrequent;
+	    else if (!strcmp(*(argv + 1), "lru"))
+		tlbPolicy = TLBLeastRecent;
+	    else if (!strcmp(*(argv + 1), "plru"))
+		tlbPolicy = TLBPseudoLRU;
+	    else if (!strcmp(*(argv + 1), "random"))
+		tlbPolicy = TLBRandom;
+	    else if (!strcmp(*(argv + 1), "clock"))
+		tlbPolicy = TLBClock;
+	    else
+		ASSERT(FALSE);		// unknown policy
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-load")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "lazy"))
+		loadMode = LoadLazy;
+	    else if (!strcmp(*(argv + 1), "eager"))
+		loadMode = LoadEager;
+	    else if (!strcmp(*(argv + 1), "hybrid"))
+		loadMode = LoadHybrid;
+	    else
+		ASSERT(FALSE);		// unknown mode
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-superpage")) {
+	    ASSERT(argc > 1);
+	    superpageSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-mem")) {
+	    ASSERT(argc > 1);
+	    numPhysPages = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pagesize")) {
+	    ASSERT(argc > 1);
+	    pageSize = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pageout")) {
+	    pageoutDaemon = TRUE;
+	} else if (!strcmp(*argv, "-pff")) {
+	    frameQuotas = TRUE;
+	} else if (!strcmp(*argv, "-loadctl")) {
+	    frameQuotas = loadControl = TRUE;
+	} else if (!strcmp(*argv, "-fa")) {
+	    ASSERT(argc > 1);
+	    faultAround = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pagerepl")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "lfu"))
+		pagePolicy = PageLeastFrequent;
+	    else if (!strcmp(*(argv + 1), "clock"))
+		pagePolicy = PageClock;
+	    else if (!strcmp(*(argv + 1), "esc"))
+		pagePolicy = PageSecondChance;
+	    else if (!strcmp(*(argv + 1), "wsclock"))
+		pagePolicy = PageWSClock;
+	    else if (!strcmp(*(argv + 1), "aging"))
+		pagePolicy = PageAging;
+	    else
+		ASSERT(FALSE);		// unknown policy
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -148,7 +233,19 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-	machine = new Machine(debugUserProg);	// this must come first
+    // pages hold whole instructions, and superpages whole pages
+    ASSERT(pageSize >= 4 && pageSize % 4 == 0 && numPhysPages > 0);
+    ASSERT(numPhysPages <= 0x7fffffff / pageSize);	// MemorySize is an int
+    ASSERT(superpageSize > 0 && numPhysPages % superpageSize == 0);
+	machine = new Machine(debugUserProg, cycleAccurate, tlbSize, tlbWays,
+				tlbPolicy, pagePolicy);	// this must come first
+    stats->superpageSize = superpageSize;
+    stats->pageSize = pageSize;
+    stats->numPhysPages = numPhysPages;
+    if (pageoutDaemon && machine->pageTable != NULL) {
+	machine->pageTable->StartPageout();
+    }
+
 	printf("USER_PROGRAM defined\n");
 #else
 	printf("USER_PROGRAM not defined\n");
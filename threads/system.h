@@ -32,8 +32,31 @@ extern Timer *timer;				// the hardware alarm clock
 #ifdef USER_PROGRAM
 #include "machine.h"
 extern Machine* machine;	// user program memory and registers
+extern int faultAround;		// most pages to load along with a 
+				// faulting one, 0 for none
+extern LoadMode loadMode;	// how much of a program to load up front
+extern bool frameQuotas;	// frames are shared out by page-fault
+				// frequency, not one global pool
+extern bool loadControl;	// and programs are suspended when their
+				// shares add up to more than memory
+extern bool pageoutDaemon;	// a kernel thread keeps frames free
+extern int superpageSize;	// pages mapped by one TLB entry, when 
+				// they can be; 1 for none
 #endif
 
+// Count "n" events of a kind against the current thread, and its
+// address space if it has one (see CounterType in stats.h).
+inline void
+CountEvent(CounterType which, int n)
+{
+    int spaceId = -1;
+#ifdef USER_PROGRAM
+    if (currentThread->space != NULL)
+	spaceId = currentThread->space->spaceId;
+#endif
+    stats->Count(which, currentThread->threadId, spaceId, n);
+}
+
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
 #include "filesys.h"
 extern FileSystem  *fileSystem;
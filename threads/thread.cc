@@ -59,6 +59,7 @@ Thread::Thread(char* threadName, int a_priority, int a_userId)
 
 // at most 128 threads can exist
 	ASSERT(i < MAX_ALLOWED_THREAD);
+	stats->ClearThreadCounters(threadId);
 // userId,priority = 0, as default
 	userId = a_userId;
 	if(a_priority > MaxPriority){
@@ -117,6 +117,7 @@ class Thread {
 	void setPriority(int newPrior){priority = newPrior;}
 	
 	int getThreadId(){return threadId;}
+	static Thread *getThread(int id){return threadPool[id];}
 	void setSlice(){ timeSlice = (priority + 1) * 100; }
 	void reduceSlice(int slice){ timeSlice -= slice; }
 	int getSlice(){ return timeSlice; }
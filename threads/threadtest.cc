@@ -169,6 +169,94 @@ ThreadTest4()
 	}
 }
 
+//----------------------------------------------------------------------
+// EventQueueStep
+// 	One step of the "hold" model used to time a queue of pending 
+//	interrupts: take the next interrupt off and schedule a new one a
+//	random time after it, the way a device re-arms itself.  The new 
+//	interrupt is one of the old ones, recycled.  Fold what came off
+//	into "*sum", so that two queues can be checked to fire the same
+//	interrupts in the same order.
+//----------------------------------------------------------------------
+
+static int
+EventQueueDelay()
+{
+    return (Random() % 100 == 0) ? 1 + Random() % 100000 : 1 + Random() % 200;
+}
+
+static void
+EventQueueStep(PendingInterrupt *next, unsigned *sum)
+{
+    *sum = *sum * 31 + next->arg;
+    next->when += EventQueueDelay();
+    next->arg = Random();
+}
+
+//----------------------------------------------------------------------
+// ThreadTest5
+// 	Time the queue of pending interrupts (PendingQueue) against the 
+//	sorted List it replaced, under the same sequence of millions of
+//	schedule/fire steps, with "EventQueueDepth" interrupts pending.
+//	Equal times are common, so this also checks that both fire them 
+//	in the same order.
+//----------------------------------------------------------------------
+
+#define EventQueueSteps	2000000
+#define EventQueueDepth	64
+
+void
+ThreadTest5()
+{
+    PendingQueue *queue = new PendingQueue();
+    List *list = new List();
+    PendingInterrupt *next;
+    unsigned queueSum = 0, listSum = 0;
+    double start, queueTime, listTime;
+    int i, when;
+
+    DEBUG('t', "Entering ThreadTest5");
+
+    RandomInit(1);
+    for (i = 0; i < EventQueueDepth; i++)
+	queue->Insert(new PendingInterrupt(NULL, Random(), 
+				EventQueueDelay(), TimerInt));
+    start = HostTime();
+    for (i = 0; i < EventQueueSteps; i++) {
+	next = queue->Remove();
+	EventQueueStep(next, &queueSum);
+	queue->Insert(next);
+    }
+    queueTime = HostTime() - start;
+
+    RandomInit(1);
+    for (i = 0; i < EventQueueDepth; i++) {
+	next = new PendingInterrupt(NULL, Random(), EventQueueDelay(),
+				TimerInt);
+	list->SortedInsert(next, next->when);
+    }
+    start = HostTime();
+    for (i = 0; i < EventQueueSteps; i++) {
+	next = (PendingInterrupt *) list->SortedRemove(&when);
+	EventQueueStep(next, &listSum);
+	list->SortedInsert(next, next->when);
+    }
+    listTime = HostTime() - start;
+
+    printf("Event queue: %d steps, %d pending\n", EventQueueSteps, 
+		EventQueueDepth);
+    printf("Event queue: heap %.3f seconds, sorted list %.3f seconds\n", 
+		queueTime, listTime);
+    ASSERT(queueSum == listSum);
+
+    while (!queue->IsEmpty())
+	delete queue->Remove();
+    while (!list->IsEmpty())
+	delete (PendingInterrupt *) list->Remove();
+    delete queue;
+    delete list;
+}
+
 //----------------------------------------------------------------------
 // ThreadTest
 // 	Invoke a test routine.
@@ -186,6 +274,8 @@ ThreadTest()
 		ThreadTest3();break;
 	case 4:
 		ThreadTest4();break;
+	case 5:
+		ThreadTest5();break;
 	break;
     default:
 	printf("No test specified.\n");
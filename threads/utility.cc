@@ -21,7 +21,8 @@
 #endif
 #endif
 
-static char *enableFlags = NULL; // controls which DEBUG messages are printed 
+bool debugFlags[256];		// controls which DEBUG messages are printed;
+				// none are until DebugInit
 
 //----------------------------------------------------------------------
 // DebugInit
@@ -37,7 +38,12 @@ static char *enableFlags = NULL; // controls which DEBUG messages are printed
 void
 DebugInit(char *flagList)
 {
-    enableFlags = flagList;
+    bool all = (flagList != NULL) && (strchr(flagList, '+') != 0);
+
+    for (int i = 0; i < 256; i++)
+	debugFlags[i] = all;
+    for (; (flagList != NULL) && (*flagList != '\0'); flagList++)
+	debugFlags[(unsigned char) *flagList] = TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -48,11 +54,7 @@ DebugInit(char *flagList)
 bool
 DebugIsEnabled(char flag)
 {
-    if (enableFlags != NULL)
-       return (strchr(enableFlags, flag) != 0) 
-		|| (strchr(enableFlags, '+') != 0);
-    else
-      return FALSE;
+    return debugFlags[(unsigned char) flag];
 }
 
 //----------------------------------------------------------------------
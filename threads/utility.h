@@ -65,6 +65,33 @@ extern bool DebugIsEnabled(char flag); 	// Is this debug flag enabled?
 extern void DEBUG (char flag, char* format, ...);  	// Print debug message 
 							// if flag is enabled
 
+extern bool debugFlags[];		// which flags are enabled, indexed by
+					// the flag character
+
+//----------------------------------------------------------------------
+// TRACE
+//      A DEBUG message on a hot path of the simulator (every memory 
+//	access, instruction or tick).  The flag is tested here, by 
+//	looking it up in "debugFlags", so a disabled message costs one 
+//	load and a branch that always goes the same way, rather than a 
+//	call with the arguments.  In a release build (-DRELEASE, see 
+//	"make release") the message is compiled out altogether.
+//
+//	TraceIsEnabled is the matching test, for tracing code that is
+//	more than one DEBUG call.
+//----------------------------------------------------------------------
+#ifdef RELEASE
+#define TRACE(flag, ...)	do { } while (0)
+#define TraceIsEnabled(flag)	FALSE
+#else
+#define TRACE(flag, ...)						      \
+    do {								      \
+	if (debugFlags[(unsigned char) (flag)])				      \
+	    DEBUG(flag, __VA_ARGS__);					      \
+    } while (0)
+#define TraceIsEnabled(flag)	(debugFlags[(unsigned char) (flag)])
+#endif
+
 //----------------------------------------------------------------------
 // ASSERT
 //      If condition is false,  print a message and dump core.
@@ -45,6 +45,8 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+static int swapFiles = 0;		// to give each swap file a new name
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
@@ -57,25 +59,47 @@ SwapHeader (NoffHeader *noffH)
 //	memory.  For now, this is really simple (1:1), since we are
 //	only uniprogramming, and we have a single unsegmented page table
 //
+//	Pages are loaded on demand (see PageTable::Swap and LoadPage), so
+//	we hang on to "executable" until we are deleted.  Modified pages
+//	that have to leave memory go to a swap area of our own, a UNIX 
+//	file that is unlinked as soon as it is open, so that it goes 
+//	away with us (or with Nachos).
+//
 //	"executable" is the file containing the object code to load into memory
+//	"mode" says which pages to load before the program starts (see 
+//		Preload); the others are loaded when they fault
 //----------------------------------------------------------------------
 
-AddrSpace::AddrSpace(OpenFile *executable)
+AddrSpace::AddrSpace(OpenFile *executable, LoadMode mode)
 {
-    unsigned int i, size;
+    unsigned int size;
+    char swapName[32];
 
+    program = executable;
+    programId = executable->Identity();
+    loadMode = mode;
     executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
     if ((noffH.noffMagic != NOFFMAGIC) && 
 		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
     	SwapHeader(&noffH);
     ASSERT(noffH.noffMagic == NOFFMAGIC);
 
-	// how big is address space?
-    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
-			+ UserStackSize;	// we need to increase the size
-						// to leave room for the stack
-    numPages = divRoundUp(size, PageSize);
+    numSegments = 0;
+    if (noffH.code.size > 0)
+	segments[numSegments++] = noffH.code;
+    if (noffH.initData.size > 0)
+	segments[numSegments++] = noffH.initData;
+    faultWindow = 1;
+    streamNext = -1;
+
+	// how big is address space?  The program goes at the bottom, and
+	// the stack at the very top, with nothing in between.
+    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size;
+    programPages = divRoundUp(size, PageSize);
+    stackBottom = MaxVirtualPages - divRoundUp(UserStackSize, PageSize);
+    numPages = programPages + MaxVirtualPages - stackBottom;
     size = numPages * PageSize;
+    ASSERT(programPages <= stackBottom);
 
     //now we do have virtual memory
 	//ASSERT(numPages <= NumPhysPages);		// check we're not trying
@@ -103,16 +127,321 @@ AddrSpace::AddrSpace(OpenFile *executable)
 //			noffH.initData.size, noffH.initData.inFileAddr);
 //    }
 
+    sprintf(swapName, "SWAP.%d", swapFiles++);
+    swapFile = OpenForWrite(swapName);
+    Unlink(swapName);
+    swapMap = new BitMap(numPages);
+    swapSlot = new PageDirectory(MaxVirtualPages);
+    directory = new PageDirectory(MaxVirtualPages);
+    asid = 0;
+    asidGeneration = -1;		// none yet
+    spaceId = stats->numSpaces++;
+    resident = 0;
+    quota = InitialQuota;
+    lastFault = stats->totalTicks;
+    suspended = FALSE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create a copy of an address space, for Fork.  Only what is not in
+//	memory is copied here: the pages the parent has saved in its swap
+//	area.  Its pages in memory are given to the child by the page 
+//	table, which maps them copy-on-write, so forking costs nothing
+//	per resident page.
+//
+//	"parent" is the address space to copy
+//	"executable" is the same program, opened again for the child
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(AddrSpace *parent, OpenFile *executable)
+{
+    unsigned int i;
+    char swapName[32];
+    char *buffer;
+
+    program = executable;
+    programId = parent->programId;
+    loadMode = parent->loadMode;
+    noffH = parent->noffH;
+    numPages = parent->numPages;
+    programPages = parent->programPages;
+    stackBottom = parent->stackBottom;
+    stackEnd = parent->stackEnd;
+    numSegments = parent->numSegments;
+    for (i = 0; i < (unsigned) numSegments; i++)
+	segments[i] = parent->segments[i];
+    faultWindow = 1;
+    streamNext = -1;
+
+    sprintf(swapName, "SWAP.%d", swapFiles++);
+    swapFile = OpenForWrite(swapName);
+    Unlink(swapName);
+    swapMap = new BitMap(numPages);
+    swapSlot = new PageDirectory(MaxVirtualPages);
+    directory = new PageDirectory(MaxVirtualPages);
+    asid = 0;
+    asidGeneration = -1;		// none yet
+    spaceId = stats->numSpaces++;
+    resident = 0;			// until the frames are shared
+    quota = parent->quota;
+    lastFault = stats->totalTicks;
+    suspended = FALSE;
+    buffer = new char[PageSize];
+    for (i = 0; i < numPages; i++) {
+	if (parent->SwapIn(PageAt(i), buffer))
+	    SwapOut(PageAt(i), buffer);
+    }
+    delete [] buffer;
+    DEBUG('a', "Forked address space, num pages %d\n", numPages);
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space: close the executable, and free the
+//	swap area.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+    delete program;
+    Close(swapFile);
+    delete swapMap;
+    delete swapSlot;
+    if (machine->pageDirectory == directory)
+	machine->pageDirectory = NULL;
+    delete directory;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Contains
+// 	Return TRUE if virtual page "vpn" is part of the address space:
+//	the program, or the stack.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Contains(int vpn)
+{
+    return (vpn >= 0 && vpn < programPages) 
+		|| (vpn >= stackBottom && vpn < (int) MaxVirtualPages);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageAt
+// 	Return the virtual page number of the "i"th page of the address 
+//	space, counting the program's pages and then the stack's.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::PageAt(int i)
+{
+    return (i < programPages) ? i : stackBottom + i - programPages;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadPage
+// 	Read a virtual page from the executable: the part of the code and
+//	of the initialized data that falls in the page, from where it is 
+//	in the file.  The rest of the page -- uninitialized data, stack --
+//	is zero, and a page with nothing in the file is just cleared, 
+//	without touching the executable.
+//
+//	"vpn" is the virtual page
+//	"into" is where to put its contents in physical memory
+//
+// Returns:
+//	TRUE if the page holds nothing but code, so it can be mapped 
+//	read-only.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::LoadPage(int vpn, char *into)
+{
+    // unsigned: the end of the top page of the stack is 2 GB
+    unsigned int pageBegin = (unsigned) vpn * PageSize;
+    unsigned int pageEnd = pageBegin + PageSize;
+    unsigned int begin, end;
+    int i, inFile;
+    Segment *seg;
+
+    for (i = 0, inFile = 0; i < numSegments; i++) {
+	begin = max(pageBegin, (unsigned) segments[i].virtualAddr);
+	end = min(pageEnd, (unsigned) (segments[i].virtualAddr 
+						+ segments[i].size));
+	if (begin < end)
+	    inFile += end - begin;
+    }
+    if (inFile < PageSize)
+	bzero(into, PageSize);
+    if (inFile == 0) {
+	stats->numZeroFills++;
+	return FALSE;
+    }
+
+    for (i = 0; i < numSegments; i++) {
+	seg = &segments[i];
+	begin = max(pageBegin, (unsigned) seg->virtualAddr);
+	end = min(pageEnd, (unsigned) (seg->virtualAddr + seg->size));
+	if (begin < end)
+	    program->ReadAt(into + (begin - pageBegin), end - begin,
+				seg->inFileAddr + (begin - seg->virtualAddr));
+    }
+    return (noffH.code.size > 0 
+		&& pageBegin >= (unsigned) noffH.code.virtualAddr
+		&& pageEnd <= (unsigned) (noffH.code.virtualAddr 
+						+ noffH.code.size));
+}
+
+//----------------------------------------------------------------------
+// PagesWithin
+// 	Return how many pages, starting at "vpn", lie entirely inside
+//	segment "seg", 0 if "vpn" doesn't.
+//----------------------------------------------------------------------
+
+static int
+PagesWithin(Segment *seg, int vpn)
+{
+    unsigned int begin = (unsigned) vpn * PageSize;	// up to 2 GB
+    unsigned int end = seg->virtualAddr + seg->size;
 
+    if (begin < (unsigned) seg->virtualAddr || begin + PageSize > end)
+	return 0;
+    return (end - begin) / PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FaultAround
+// 	Page "vpn" just faulted: decide how many of the pages after it to
+//	load along with it.  A fault on the page right after the ones 
+//	loaded last time means we are going through memory in order, so
+//	we double the window, up to "most"; any other fault puts it back
+//	to one page.
+//
+//	Only pages lying entirely in the code or initialized data, and 
+//	never saved to the swap area, qualify: they are contiguous in 
+//	the executable, and can be read in one go (see LoadPages).
+//
+//	"vpn" is the page that faulted
+//	"most" is the largest window
+//----------------------------------------------------------------------
+
+int
+AddrSpace::FaultAround(int vpn, int most)
+{
+    int count, i;
+
+    if (vpn == streamNext)
+	faultWindow = min(2 * faultWindow, most);
+    else
+	faultWindow = min(1, most);
+    streamNext = vpn + 1;		// unless LoadPages is called
+
+    count = max(PagesWithin(&noffH.code, vpn + 1),
+		PagesWithin(&noffH.initData, vpn + 1));
+    count = min(count, faultWindow);
+    for (i = 0; i < count; i++) {
+	if (swapSlot->Find(vpn + 1 + i) != -1)
+	    break;
+    }
+    return i;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadPages
+// 	Read "count" consecutive pages, starting at "vpn", from the 
+//	executable with a single ReadAt, and spread them over the frames
+//	"into".  They must lie in a single segment (see FaultAround).
+//
+// Returns:
+//	TRUE if they are code, so they can be mapped read-only.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::LoadPages(int vpn, int count, char **into)
+{
+    Segment *seg = PagesWithin(&noffH.code, vpn) ? &noffH.code 
+						   : &noffH.initData;
+    char *buffer = new char[count * PageSize];
+    int i;
+
+    ASSERT(PagesWithin(seg, vpn) >= count);
+    program->ReadAt(buffer, count * PageSize, 
+			seg->inFileAddr + vpn * PageSize - seg->virtualAddr);
+    for (i = 0; i < count; i++)
+	bcopy(buffer + i * PageSize, into[i], PageSize);
+    delete [] buffer;
+    streamNext = vpn + count;
+    return (seg == &noffH.code);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CodeOffset
+// 	Say where a page that holds nothing but code is in the executable.
+//	Such a page is the same in every address space running the 
+//	program, and is never written, so it can be shared by all of 
+//	them (see PageTable::Bring).
+//
+// Returns:
+//	its offset in the executable, -1 if the page isn't all code.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::CodeOffset(int vpn)
+{
+    if (!PagesWithin(&noffH.code, vpn) || swapSlot->Find(vpn) != -1)
+	return -1;
+    return noffH.code.inFileAddr + vpn * PageSize - noffH.code.virtualAddr;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SwapOut
+// 	Save a modified page that is leaving physical memory in the swap
+//	area, in the slot it had before or in a free one.  Once a page
+//	has a slot, it is always read back from there (see SwapIn), so
+//	a clean copy of it can simply be dropped.
+//
+//	"vpn" is the virtual page
+//	"from" is where its contents are in physical memory
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SwapOut(int vpn, char *from)
+{
+    int slot = swapSlot->Find(vpn);
+
+    ASSERT(Contains(vpn));
+    if (slot == -1) {
+	slot = swapMap->Find();
+	ASSERT(slot != -1);		// one slot per page, so never full
+	swapSlot->Set(vpn, slot);
+    }
+    DEBUG('a', "Swapping out page %d to slot %d\n", vpn, slot);
+    Lseek(swapFile, slot * PageSize, 0);
+    WriteFile(swapFile, from, PageSize);
+    stats->numSwapWrites++;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SwapIn
+// 	Read a page back from the swap area, if it was ever saved there.
+//
+//	"vpn" is the virtual page
+//	"into" is where to put its contents in physical memory
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::SwapIn(int vpn, char *into)
+{
+    int slot = swapSlot->Find(vpn);
+
+    ASSERT(Contains(vpn));
+    if (slot == -1)
+	return FALSE;
+    DEBUG('a', "Swapping in page %d from slot %d\n", vpn, slot);
+    Lseek(swapFile, slot * PageSize, 0);
+    Read(swapFile, into, PageSize);
+    stats->numSwapReads++;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -143,32 +472,74 @@ AddrSpace::InitRegisters()
    // Set the stack register to the end of the address space, where we
    // allocated the stack; but subtract off a bit, to make sure we don't
    // accidentally reference off the end!
-	stackEnd = numPages * PageSize - 16;
+	stackEnd = MaxVirtualPages * PageSize - 16;
     machine->WriteRegister(StackReg, stackEnd);
-    DEBUG('a', "Initializing stack register to %d\n", numPages * PageSize - 16);
+    DEBUG('a', "Initializing stack register to 0x%x\n", stackEnd);
 	
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::Preload
+// 	Load the pages our load mode says to load up front, so that they
+//	don't have to fault in.  Must be called once we are the current 
+//	thread's address space, before the program starts.
+//
+//	Eager loading takes every page, if they all fit in physical memory;
+//	if not, as many as fit, keeping the last frame for the top of the
+//	stack.  Hybrid loading takes the page with the first instruction
+//	and the top of the stack.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Preload()
+{
+    PageTable *pageTable = machine->pageTable;
+    int i, count;
+
+    if (pageTable == NULL)		// no demand paging
+	return;
+    switch (loadMode) {
+      case LoadEager:
+	count = min((int) numPages, pageTable->entrySize) - 1;
+	for (i = 0; i < count; i++)
+	    pageTable->Preload(PageAt(i));
+	pageTable->Preload(MaxVirtualPages - 1);
+	break;
+      case LoadHybrid:
+	pageTable->Preload(0);		// the PC starts at 0
+	pageTable->Preload(MaxVirtualPages - 1);
+	break;
+      case LoadLazy:
+	break;
+    }
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::SaveState
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	Charge the program with the events counted while it ran.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
-{}
+{
+    machine->FlushCounts();
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      Tell the machine where to find the page table, and which
+//	TLB entries are ours.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
-    //machine->pageTable = pageTable;
+    machine->pageDirectory = directory;
+    machine->InvalidateMemo();		// they were another program's
+    if (machine->tlb != NULL)		// switch ids; the TLB is kept
+	machine->tlb->Activate(&asid, &asidGeneration);
 }
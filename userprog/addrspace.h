@@ -16,27 +16,95 @@
 #include "copyright.h"
 #include "filesys.h"
 #include "noff.h"
+#include "bitmap.h"
+#include "translate.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
 
+// How much of a program to load before it starts: nothing (everything
+// is loaded on demand, by page faults), everything that fits in 
+// memory, or just the first code page and the top of the stack, which 
+// are sure to be wanted straight away.
+enum LoadMode { LoadLazy, LoadEager, LoadHybrid };
+
 class AddrSpace {
   public:
-    AddrSpace(OpenFile *executable);	// Create an address space,
+    AddrSpace(OpenFile *executable, LoadMode mode = LoadLazy);
+					// Create an address space,
 					// initializing it with the program
-					// stored in the file "executable"
+					// stored in the file "executable",
+					// which it keeps (and closes)
+    AddrSpace(AddrSpace *parent, OpenFile *executable);
+					// Create a copy of "parent", for
+					// Fork; its pages in memory are
+					// shared (see PageTable::Share)
     ~AddrSpace();			// De-allocate an address space
 
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
+    void Preload();			// Load what the load mode says to,
+					// once we are the current space
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
+    bool Contains(int vpn);		// Is a page part of the space?
+    PageDirectory *directory;		// Where its pages are in memory
+
+    int asid;				// its id in the TLB tags,
+    int asidGeneration;			// valid in this TLB generation
+    int spaceId;			// which counters are its (see 
+					// CounterType in stats.h)
+
+    int resident;			// pages it has in memory
+    int quota;				// frames it may have (with -pff)
+    int lastFault;			// when it last page faulted
+    bool suspended;			// swapped out by load control
 	NoffHeader noffH;			// the header of the executable file
 
+    void SwapOut(int vpn, char *from);	// Save a modified page that is
+					// leaving memory in the swap area
+    bool SwapIn(int vpn, char *into);	// Read back a page saved there;
+					// FALSE if it never was
+    bool LoadPage(int vpn, char *into);	// Read a page from the executable;
+					// TRUE if it is all code
+    int FaultAround(int vpn, int most);	// How many of the pages after a
+					// faulting one to load with it
+    bool LoadPages(int vpn, int count, char **into);
+					// Read them with one ReadAt
+    int CodeOffset(int vpn);		// Where a page of pure code is in
+					// the executable, -1 if it isn't one
+    int ProgramId() { return programId; }
+					// Which executable we are running
+
   private:
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    int programPages;			// pages 0 .. programPages-1 hold
+					// code and data,
+    int stackBottom;			// and stackBottom .. the last page
+					// of the 2 GB, the stack
 	int stackEnd;
+    int PageAt(int i);			// the "i"th page of the space
+    LoadMode loadMode;			// what to load before we start
+
+    OpenFile *program;			// the executable, kept open so page 
+					// faults can read it straight away
+    int programId;			// its identity, the same for every
+					// address space running it
+    Segment segments[2];		// where its non-empty code and data
+    int numSegments;			// are, in memory and in the file;
+					// everything else starts out zero
+
+    int faultWindow;			// pages to load after the next fault,
+					// if it continues the stream
+    int streamNext;			// the page right after the ones 
+					// loaded for the last fault
+
+    int swapFile;			// UNIX file holding the swap area
+    BitMap *swapMap;			// which page-sized slots of the 
+					// swap area are in use
+    PageDirectory *swapSlot;		// for each virtual page, its slot
+					// in the swap area, -1 if none
 };
 
 #endif // ADDRSPACE_H
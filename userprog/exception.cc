@@ -24,6 +24,85 @@
 #include "copyright.h"
 #include "system.h"
 #include "syscall.h"
+#include "addrspace.h"
+
+//----------------------------------------------------------------------
+// AdvancePC
+// 	Move the user program past the syscall instruction, so that it
+//	doesn't make the same call again when it resumes.
+//----------------------------------------------------------------------
+
+static void
+AdvancePC()
+{
+    machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+    machine->WriteRegister(PCReg, machine->ReadRegister(NextPCReg));
+    machine->WriteRegister(NextPCReg, machine->ReadRegister(NextPCReg) + 4);
+}
+
+//----------------------------------------------------------------------
+// ForkedUserThread
+// 	Where a thread made by Fork starts, in the kernel: load the user
+//	registers it was given, and jump to "func" in its address space.
+//----------------------------------------------------------------------
+
+static void
+ForkedUserThread(int func)
+{
+    currentThread->RestoreUserState();
+    currentThread->space->RestoreState();
+    machine->WriteRegister(PCReg, func);
+    machine->WriteRegister(NextPCReg, func + 4);
+    machine->Run();			// never returns; the thread exits
+    ASSERT(FALSE);			// by doing the syscall "exit"
+}
+
+//----------------------------------------------------------------------
+// ForkUser
+// 	Handle the Fork syscall: make a new thread with a copy of the
+//	current one's address space and user registers, to run "func".
+//	The copy is copy-on-write: the page table maps the child to the
+//	parent's frames, read-only, so nothing is copied until one of 
+//	them writes (see PageTable::CopyOnWrite).
+//----------------------------------------------------------------------
+
+static void
+ForkUser(int func)
+{
+    Thread *child = new Thread("forked user thread");
+    OpenFile *executable = fileSystem->Open(currentThread->userFileName);
+
+    ASSERT(executable != NULL && machine->pageTable != NULL);
+    child->userFileName = currentThread->userFileName;
+    child->space = new AddrSpace(currentThread->space, executable);
+    child->SaveUserState();		// it starts from our registers
+    machine->pageTable->Share(currentThread->threadId, child->threadId);
+    stats->numForks++;
+    DEBUG('a', "Forked thread %d from %d, to run 0x%x\n", 
+		child->threadId, currentThread->threadId, func);
+    child->Fork(ForkedUserThread, func);
+}
+
+//----------------------------------------------------------------------
+// ReadCounter
+// 	Handle the Counter syscall: return counter "which" of the current
+//	thread ("whose" is CounterThread) or of its address space 
+//	(CounterSpace); -1 if there is no such counter.
+//----------------------------------------------------------------------
+
+static int
+ReadCounter(int which, int whose)
+{
+    if (which < 0 || which >= NumCounters)
+	return -1;
+    machine->FlushCounts();		// up to this system call
+    if (whose == CounterThread)
+	return stats->ThreadCount((CounterType) which, currentThread->threadId);
+    if (whose == CounterSpace)
+	return stats->SpaceCount((CounterType) which, 
+				 currentThread->space->spaceId);
+    return -1;
+}
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -53,12 +132,40 @@ ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
 	int vpn;
+	double start;
     switch (which) {
 		case SyscallException:
+			CountEvent(SyscallCounter, 1);
 			if (type == SC_Halt) {
 				DEBUG('a', "Shutdown, initiated by user program.\n");
 				interrupt->Halt();
 			}
+			else if (type == SC_Exit) {
+				DEBUG('a', "User program exited with status %d.\n",
+					machine->ReadRegister(4));
+				// its frames and its swap area are free now
+				machine->FlushCounts();
+				if (machine->pageTable != NULL)
+					machine->pageTable->Release(currentThread->threadId);
+				if (machine->tlb != NULL)
+					stats->RecordProcessTLB(currentThread->threadId,
+						stats->SpaceCount(TLBHitCounter, 
+							currentThread->space->spaceId), 
+						stats->SpaceCount(TLBMissCounter, 
+							currentThread->space->spaceId));
+				delete currentThread->space;
+				currentThread->space = NULL;
+				currentThread->Finish();
+			}
+			else if (type == SC_Fork) {
+				ForkUser(machine->ReadRegister(4));
+				AdvancePC();
+			}
+			else if (type == SC_Counter) {
+				machine->WriteRegister(2, ReadCounter(
+					machine->ReadRegister(4), machine->ReadRegister(5)));
+				AdvancePC();
+			}
 			else{
 				printf("Undefined system call exception %d %d\n", which, type);
 				ASSERT(FALSE);				
@@ -66,7 +173,15 @@ ExceptionHandler(ExceptionType which)
 			break;
 			
 		case TLBMissException:
-			machine->tlb->Swap();
+			// time one miss in TLBMissSample, so the timing
+			// itself hardly slows the simulator down
+			if (stats->tlbMiss % TLBMissSample == 0) {
+				start = HostTime();
+				machine->tlb->Swap();
+				stats->tlbMissHostTime += HostTime() - start;
+				stats->numTimedMisses++;
+			} else
+				machine->tlb->Swap();
 			break;
 			
 		case PageFaultException:
@@ -74,6 +189,15 @@ ExceptionHandler(ExceptionType which)
 			machine->pageTable->Swap(vpn);
 			break;			
 		
+		case ReadOnlyException:
+			// a write to a page shared copy-on-write by Fork
+			vpn = machine->ReadRegister(BadVAddrReg) / PageSize;
+			if (!machine->pageTable->CopyOnWrite(vpn)) {
+				printf("Write to read-only page %d\n", vpn);
+				ASSERT(FALSE);
+			}
+			break;
+		
 		default:
 			printf("Unexpected user mode exception %d %d\n", which, type);
 			ASSERT(FALSE);
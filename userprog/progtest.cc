@@ -14,15 +14,22 @@
 #include "addrspace.h"
 #include "synch.h"
 
+static char *loadModeNames[] = { "lazy", "eager", "hybrid" };
+
 //----------------------------------------------------------------------
 // StartProcess
 // 	Run a user program.  Open the executable, load it into
-//	memory, and jump to it.
+//	memory (as much of it as "loadMode" says), and jump to it.
+//
+//	The time this takes is added up in the statistics, as the 
+//	startup latency.
 //----------------------------------------------------------------------
 
 void
 StartProcess(char *filename)
 {
+    int startTicks = stats->totalTicks;
+    double startTime = HostTime();
     OpenFile *executable = fileSystem->Open(filename);
     AddrSpace *space;
 
@@ -30,14 +37,20 @@ StartProcess(char *filename)
 	printf("Unable to open file %s\n", filename);
 	return;
     }
-    space = new AddrSpace(executable);    
+    space = new AddrSpace(executable, loadMode);
+					// keeps the file open, to load
+					// pages from it on demand
     currentThread->space = space;
 	currentThread->userFileName = filename;
 
-    delete executable;			// close file
-
     space->InitRegisters();		// set the initial register values
     space->RestoreState();		// load page table register
+    space->Preload();			// load what isn't left to faults
+
+    stats->loadMode = loadModeNames[loadMode];
+    stats->numStartups++;
+    stats->startupTicks += stats->totalTicks - startTicks;
+    stats->startupHostTime += HostTime() - startTime;
 
     machine->Run();			// jump to the user progam
     ASSERT(FALSE);			// machine->Run never returns;
@@ -29,6 +29,7 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_Counter	11
 
 #ifndef IN_ASM
 
@@ -114,8 +115,10 @@ void Close(OpenFileId id);
  * threads to run within a user program. 
  */
 
-/* Fork a thread to run a procedure ("func") in the *same* address space 
- * as the current thread.
+/* Fork a thread to run a procedure ("func") in a copy of the current 
+ * thread's address space.  The copy shares the parent's memory until 
+ * one of them writes to a page, so forking is cheap however big the
+ * program is.  "func" must end by calling Exit, not return.
  */
 void Fork(void (*func)());
 
@@ -124,6 +127,29 @@ void Fork(void (*func)());
  */
 void Yield();		
 
+
+/* Performance counters, kept for each thread and each address space.
+ * Which counter (in the order of CounterType in machine/stats.h):
+ */
+#define CounterInstructions	0	/* user instructions retired */
+#define CounterLoads		1	/* loads from memory */
+#define CounterStores		2	/* stores to memory */
+#define CounterBranches		3	/* branches and jumps taken */
+#define CounterTLBHits		4
+#define CounterTLBMisses	5
+#define CounterPageFaults	6
+#define CounterSyscalls		7
+#define CounterSwitches		8	/* times switched to */
+
+/* And whose: */
+#define CounterThread		0	/* the calling thread's */
+#define CounterSpace		1	/* its address space's */
+
+/* Return counter "which" of "whose" so far, or -1 if there is no such
+ * counter.  All of them are printed when Nachos halts.
+ */
+int Counter(int which, int whose);
+
 #endif /* IN_ASM */
 
 #endif /* SYSCALL_H */